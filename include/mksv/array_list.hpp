@@ -27,10 +27,7 @@ struct ArrayList {
         u64 new_cap = calculate_new_size(capacity);
         if (new_cap == items.len) return false;
 
-        if (allocator.resize(items, new_cap)) {
-            items.len = new_cap;
-            return true;
-        }
+        if (allocator.remap(&items, new_cap)) return true;
 
         mem::Slice<T> new_items = {};
         if (!allocator.alloc<T>(new_cap, &new_items)) return false;
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "ctx.hpp"
+#include "types.hpp"
+
+#if COMPILER_CL
+#include <intrin.h>
+#elif !(COMPILER_CLANG || COMPILER_GCC)
+#error "Unsupported compiler"
+#endif
+
+namespace mksv {
+namespace atomic {
+
+#if COMPILER_CL
+// The Interlocked intrinsics work on long and __int64, values are reinterpreted
+// through a same-sized integer so pointers and unsigned types work too
+template <u64 size>
+struct WordOf;
+
+template <>
+struct WordOf<4> {
+    using Type = long;
+};
+
+template <>
+struct WordOf<8> {
+    using Type = __int64;
+};
+
+template <typename T>
+using Word = typename WordOf<sizeof(T)>::Type;
+
+template <typename T>
+inline Word<T>
+to_word(const T value) {
+    return __builtin_bit_cast(Word<T>, value);
+}
+
+template <typename T>
+inline T
+from_word(const Word<T> value) {
+    return __builtin_bit_cast(T, value);
+}
+#endif
+
+template <typename T>
+inline T
+load(const T* ptr) {
+#if COMPILER_CL
+    // Aligned loads are acquire on x64, the barrier stops compiler reordering
+    const T value = *(const volatile T*)ptr;
+    _ReadWriteBarrier();
+    return value;
+#else
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#endif
+}
+
+template <typename T>
+inline void
+store(T* ptr, const T value) {
+#if COMPILER_CL
+    _ReadWriteBarrier();
+    *(volatile T*)ptr = value;
+#else
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+#endif
+}
+
+template <typename T>
+inline T
+exchange(T* ptr, const T value) {
+#if COMPILER_CL
+    if constexpr (sizeof(T) == 4) {
+        return from_word<T>(_InterlockedExchange((volatile long*)ptr, to_word(value)));
+    } else {
+        return from_word<T>(_InterlockedExchange64((volatile __int64*)ptr, to_word(value)));
+    }
+#else
+    return __atomic_exchange_n(ptr, value, __ATOMIC_ACQ_REL);
+#endif
+}
+
+// Returns the previous value
+template <typename T>
+inline T
+fetch_add(T* ptr, const T value) {
+#if COMPILER_CL
+    if constexpr (sizeof(T) == 4) {
+        return from_word<T>(_InterlockedExchangeAdd((volatile long*)ptr, to_word(value)));
+    } else {
+        return from_word<T>(_InterlockedExchangeAdd64((volatile __int64*)ptr, to_word(value)));
+    }
+#else
+    return __atomic_fetch_add(ptr, value, __ATOMIC_ACQ_REL);
+#endif
+}
+
+// On failure, expected is updated with the current value
+template <typename T>
+inline bool
+compare_exchange(T* ptr, T* expected, const T desired) {
+#if COMPILER_CL
+    const Word<T> comparand = to_word(*expected);
+    Word<T> previous;
+    if constexpr (sizeof(T) == 4) {
+        previous = _InterlockedCompareExchange((volatile long*)ptr, to_word(desired), comparand);
+    } else {
+        previous = _InterlockedCompareExchange64(
+            (volatile __int64*)ptr, to_word(desired), comparand
+        );
+    }
+    if (previous == comparand) return true;
+    *expected = from_word<T>(previous);
+    return false;
+#else
+    return __atomic_compare_exchange_n(
+        ptr, expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE
+    );
+#endif
+}
+
+inline void
+spin_pause() {
+#if ARCH_X64 && COMPILER_CL
+    _mm_pause();
+#elif ARCH_X64
+    __builtin_ia32_pause();
+#endif
+}
+
+struct SpinLock {
+    u32 state = 0;
+
+    [[nodiscard]] bool
+    try_lock() {
+        return load(&state) == 0 && exchange(&state, 1u) == 0;
+    }
+
+    void
+    lock() {
+        while (!try_lock()) {
+            while (load(&state) != 0) spin_pause();
+        }
+    }
+
+    void
+    unlock() {
+        store(&state, 0u);
+    }
+};
+
+} // namespace atomic
+} // namespace mksv
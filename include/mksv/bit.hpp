@@ -42,6 +42,50 @@ clz(u32 x) {
     return n;
 }
 
+inline constexpr u32
+clz(const u64 x) {
+    if (x == 0) return 64;
+#if COMPILER_CLANG || COMPILER_GCC
+    return (u32)__builtin_clzll(x);
+#else
+    u32 n = 0;
+    while ((x & ((u64)1 << (63 - n))) == 0) ++n;
+    return n;
+#endif
+}
+
+inline constexpr u32
+ctz(const u64 x) {
+    if (x == 0) return 64;
+#if COMPILER_CLANG || COMPILER_GCC
+    return (u32)__builtin_ctzll(x);
+#else
+    u32 n = 0;
+    while ((x & ((u64)1 << n)) == 0) ++n;
+    return n;
+#endif
+}
+
+inline constexpr u32
+pop_count(u64 x) {
+#if COMPILER_CLANG || COMPILER_GCC
+    return (u32)__builtin_popcountll(x);
+#else
+    u32 n = 0;
+    while (x != 0) {
+        x &= x - 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+// Index of the highest set bit, x must not be 0
+inline constexpr u32
+log2(const u64 x) {
+    return 63 - clz(x);
+}
+
 template <typename T>
 inline constexpr T
 rotate_left(const T n, u8 count) {
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "atomic.hpp"
 #include "mem.hpp"
 #include "singly_linked_list.hpp"
+#include "utils.hpp"
 
 namespace mksv {
 namespace heap {
@@ -9,21 +11,375 @@ namespace heap {
 mem::Allocator
 system_allocator();
 
+constexpr u64 HUGE_PAGE_SIZE = math::mega_bytes((u64)2);
+
+// Same as system_allocator(), but allocations of at least HUGE_PAGE_SIZE are backed by huge
+// pages. Uses MAP_HUGETLB when the system has huge pages reserved, otherwise aligns the mapping
+// to HUGE_PAGE_SIZE and asks for transparent huge pages. remap() moves huge blocks with mremap,
+// keeping them aligned to HUGE_PAGE_SIZE
+mem::Allocator
+huge_page_allocator();
+
 struct ArenaAllocator {
     using Stack = SinglyLinkedList<mem::Slice<u8>>;
     using Node = Stack::Node;
     static constexpr u64 NODE_SIZE = sizeof(Node);
 
+    // Position in the arena, see save() and restore()
+    struct Marker {
+        Node* node;
+        u64 end_idx;
+    };
+
     mem::Allocator inner_allocator;
     Stack stack;
     u64 end_idx;
+    // Nodes released by restore() or reset(), reused before asking inner_allocator
+    Stack free_nodes;
+    u64 retained_bytes;
+    u64 retain_limit;
 
     static ArenaAllocator
     init(const mem::Allocator inner);
 
+    // Keeps at most retain_limit bytes of released nodes for reuse
+    static ArenaAllocator
+    init(const mem::Allocator inner, const u64 retain_limit);
+
+    mem::Allocator
+    allocator() const;
+
+    Marker
+    save() const;
+
+    // Frees everything allocated since marker was saved
+    void
+    restore(const Marker marker);
+
+    // Frees everything, keeping up to retain_limit bytes of nodes for reuse
+    void
+    reset();
+
+    void
+    deinit();
+};
+
+// Allocates blocks of a single size and alignment from chunks of inner allocator memory.
+// Freed blocks are kept in an intrusive free list and reused in O(1)
+struct PoolAllocator {
+    using Chunks = SinglyLinkedList<mem::Slice<u8>>;
+    using Chunk = Chunks::Node;
+    static constexpr u64 CHUNK_SIZE = math::kilo_bytes(64);
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    mem::Allocator inner_allocator;
+    Chunks chunks;
+    FreeBlock* free_list;
+    // Unused part of the most recent chunk
+    u8* bump_ptr;
+    u8* bump_end;
+    u64 block_size;
+    u64 block_alignment;
+
+    static PoolAllocator
+    init(const mem::Allocator inner, const u64 size, const u64 alignment);
+
+    template <typename T>
+    static PoolAllocator
+    init(const mem::Allocator inner) {
+        return init(inner, sizeof(T), alignof(T));
+    }
+
+    mem::Allocator
+    allocator() const;
+
+    void
+    deinit();
+};
+
+// Serves small requests from one PoolAllocator per power of two size class and forwards
+// large or over-aligned requests to the inner allocator
+struct GeneralPurposeAllocator {
+    static constexpr u64 MIN_CLASS_SIZE = 16;
+    static constexpr u64 MAX_CLASS_SIZE = math::kilo_bytes(8);
+    static constexpr u64 MAX_CLASS_ALIGNMENT = 64;
+    static constexpr u64 CLASS_COUNT = 10;
+
+    mem::Allocator inner_allocator;
+    PoolAllocator pools[CLASS_COUNT];
+
+    static GeneralPurposeAllocator
+    init(const mem::Allocator inner);
+
+    mem::Allocator
+    allocator() const;
+
+    void
+    deinit();
+};
+
+// Wraps a shared backend with per thread caches of free blocks, one per size class of
+// GeneralPurposeAllocator. Caches are refilled and drained BATCH_SIZE blocks at a time under
+// the lock, large requests take the lock for every call.
+// A thread cache is drained back to the backend when it gets evicted from its thread's slots
+// or when the thread exits. Threads keep the allocator's address, so it must not move once used
+// and deinit() is required before its memory is reused. deinit() must run once no thread uses
+// the allocator
+struct ThreadCachingAllocator {
+    static constexpr u64 CLASS_COUNT = GeneralPurposeAllocator::CLASS_COUNT;
+    static constexpr u64 BATCH_SIZE = 32;
+    static constexpr u64 CACHE_CAPACITY = 2 * BATCH_SIZE;
+    // Number of ThreadCachingAllocator a thread can use before caches get evicted
+    static constexpr u64 THREAD_SLOTS = 8;
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct ClassCache {
+        FreeBlock* head;
+        u64 count;
+    };
+
+    struct ThreadCache {
+        ClassCache classes[CLASS_COUNT];
+        ThreadCache* next;
+    };
+
+    mem::Allocator backend;
+    atomic::SpinLock lock;
+    // Every thread cache created by this allocator, guarded by lock
+    ThreadCache* caches;
+    u64 id;
+
+    static ThreadCachingAllocator
+    init(const mem::Allocator backend);
+
+    mem::Allocator
+    allocator() const;
+
+    void
+    deinit();
+};
+
+// Reserves a range of address space up front and commits pages as the bump pointer advances.
+// The most recent allocation can always grow in place until the reservation is exhausted,
+// so nothing is ever copied and pointers stay valid
+struct VirtualArena {
+    static constexpr u64 DEFAULT_RESERVE_SIZE = math::giga_bytes((u64)64);
+    // Minimum amount of memory committed at once
+    static constexpr u64 COMMIT_SIZE = math::kilo_bytes((u64)64);
+
+    mem::Slice<u8> reserved;
+    u64 committed;
+    u64 end_idx;
+
+    [[nodiscard]] static bool
+    init(const u64 reserve_size, VirtualArena* out_arena);
+
+    // Reserves DEFAULT_RESERVE_SIZE
+    [[nodiscard]] static bool
+    init(VirtualArena* out_arena);
+
     mem::Allocator
     allocator() const;
 
+    // Frees everything, committed pages are kept for reuse
+    void
+    reset();
+
+    void
+    deinit();
+};
+
+// Wraps an allocator and records live and peak bytes, call counts and a log2 size histogram.
+// tagged() hands out allocators whose calls are also counted under a caller chosen name, e.g.
+// one per subsystem
+struct TrackingAllocator {
+    static constexpr u64 HISTOGRAM_SIZE = 64;
+    static constexpr u64 MAX_TAGS = 16;
+
+    struct Stats {
+        u64 live_bytes;
+        u64 peak_bytes;
+        u64 alloc_count;
+        u64 free_count;
+        u64 resize_count;
+        u64 failed_alloc_count;
+        u64 failed_resize_count;
+        // histogram[i] counts allocations of [2^i, 2^(i + 1)) bytes, empty ones aren't counted
+        u64 histogram[HISTOGRAM_SIZE];
+    };
+
+    struct Tag {
+        TrackingAllocator* owner;
+        Str name;
+        Stats stats;
+    };
+
+    mem::Allocator inner_allocator;
+    Stats stats;
+    Tag tags[MAX_TAGS];
+    u64 tag_count;
+    // Tags and handed out allocators point into the tracker
+    Pinned pinned;
+
+    static TrackingAllocator
+    init(const mem::Allocator inner);
+
+    mem::Allocator
+    allocator() const;
+
+    // Returns the allocator counting under name, registering it if needed.
+    // Fails when MAX_TAGS names are already in use
+    [[nodiscard]] bool
+    tagged(const Str name, mem::Allocator* out_allocator);
+
+    Stats
+    snapshot() const;
+
+    bool
+    print_stats() const;
+};
+
+// Bump allocates from a caller owned buffer. Fails once the buffer is full, only the most
+// recent allocation can be resized or freed
+struct FixedBufferAllocator {
+    mem::Slice<u8> buffer;
+    u64 end_idx;
+
+    static FixedBufferAllocator
+    init(const mem::Slice<u8> buffer);
+
+    mem::Allocator
+    allocator() const;
+
+    void
+    reset();
+};
+
+// Arena that can be shared between threads without a lock. Memory is handed out with an atomic
+// fetch-add on the current chunk and new chunks are installed with a compare-exchange.
+// The inner allocator must be thread safe. reset() and deinit() must not race with allocations
+struct ConcurrentArena {
+    static constexpr u64 MIN_CHUNK_SIZE = math::kilo_bytes((u64)64);
+    static constexpr u64 MAX_CHUNK_SIZE = math::mega_bytes((u64)64);
+    // Every allocation starts on this alignment
+    static constexpr u64 BASE_ALIGNMENT = 16;
+
+    struct alignas(BASE_ALIGNMENT) Chunk {
+        Chunk* next;
+        u64 capacity;
+        u64 offset;
+    };
+
+    mem::Allocator inner_allocator;
+    Chunk* current;
+
+    static ConcurrentArena
+    init(const mem::Allocator inner);
+
+    mem::Allocator
+    allocator() const;
+
+    // Frees everything, keeping the most recent chunk for reuse
+    void
+    reset();
+
+    void
+    deinit();
+};
+
+// Splits a power of two region into power of two blocks and merges freed blocks with their buddy.
+// A block grows in place when the buddies on its right are free, which matches ArrayList doubling
+struct BuddyAllocator {
+    static constexpr u64 MIN_BLOCK_SIZE = 16;
+    static constexpr u64 MAX_LEVELS = 48;
+
+    struct FreeBlock {
+        FreeBlock* next;
+        FreeBlock* prev;
+    };
+
+    mem::Allocator inner_allocator;
+    mem::Slice<u8> region;
+    // One bit per block of every level, set when the block is in a free list
+    mem::Slice<u64> free_bits;
+    // Level 0 holds MIN_BLOCK_SIZE blocks, level level_count - 1 is the whole region
+    u64 level_count;
+    FreeBlock* free_lists[MAX_LEVELS];
+
+    // size is rounded up to a power of two
+    [[nodiscard]] static bool
+    init(const mem::Allocator inner, const u64 size, BuddyAllocator* out_allocator);
+
+    mem::Allocator
+    allocator() const;
+
+    void
+    deinit();
+};
+
+// TLSF style sub-allocator handing out offsets into a region it never touches, so the region
+// can be file backed, shared or persisted. Metadata lives in a separate node array.
+// Alloc and free are O(1). Offsets are multiples of g when every size is a multiple of g
+struct OffsetAllocator {
+    static constexpr u32 NONE = math::MAX_U32;
+    // Bins are a tiny float: 3 bits of mantissa, the rest is the exponent
+    static constexpr u32 MANTISSA_BITS = 3;
+    static constexpr u32 LEAF_BIN_COUNT = 1 << MANTISSA_BITS;
+    static constexpr u32 TOP_BIN_COUNT = 64;
+    static constexpr u32 BIN_COUNT = TOP_BIN_COUNT * LEAF_BIN_COUNT;
+
+    struct Allocation {
+        u64 offset;
+        // Node index, needed by free()
+        u32 metadata;
+    };
+
+    struct Node {
+        u64 offset;
+        u64 size;
+        u32 bin_prev;
+        u32 bin_next;
+        u32 neighbor_prev;
+        u32 neighbor_next;
+        bool used;
+    };
+
+    mem::Allocator metadata_allocator;
+    u64 size;
+    u64 free_storage;
+    u64 used_top_bins;
+    u8 used_leaf_bins[TOP_BIN_COUNT];
+    u32 bin_heads[BIN_COUNT];
+    mem::Slice<Node> nodes;
+    // Stack of unused node indices
+    mem::Slice<u32> free_nodes;
+    u32 free_node_count;
+
+    // max_allocs bounds the number of live allocations and free ranges
+    [[nodiscard]] static bool
+    init(
+        const mem::Allocator metadata_allocator,
+        const u64 size,
+        const u32 max_allocs,
+        OffsetAllocator* out_allocator
+    );
+
+    [[nodiscard]] bool
+    alloc(const u64 size, Allocation* out_allocation);
+
+    void
+    free(const Allocation allocation);
+
+    // Frees every allocation
+    void
+    reset();
+
     void
     deinit();
 };
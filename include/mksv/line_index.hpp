@@ -0,0 +1,24 @@
+#pragma once
+
+#include "array_list.hpp"
+#include "mem.hpp"
+
+namespace mksv {
+namespace lines {
+
+// Appends the offset of every '\n' in text to out_offsets
+[[nodiscard]] bool
+build_index(const Str text, ArrayList<u64>* out_offsets);
+
+// Same as build_index, with text split in chunks scanned by up to thread_count threads (0 means
+// one per cpu). Newlines are counted first, so out_offsets grows once and every chunk writes its
+// part in place
+[[nodiscard]] bool
+build_index_parallel(const Str text, const u32 thread_count, ArrayList<u64>* out_offsets);
+
+// Line n of text without its '\n', newlines is the index of text. There are newlines.len + 1 lines
+Str
+line_at(const Str text, const mem::Slice<u64> newlines, const u64 n);
+
+} // namespace lines
+} // namespace mksv
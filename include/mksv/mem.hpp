@@ -1,6 +1,7 @@
 #pragma once
 
 #include "assert.hpp"
+#include "bit.hpp"
 #include "math.hpp"
 #include "type_traits.hpp"
 #include "types.hpp"
@@ -87,12 +88,38 @@ struct Slice {
     }
 };
 
+// Vectorized byte routines behind copy, move, zero and equal
+void
+copy_bytes(const Slice<u8> dst, const Slice<u8> src);
+
+void
+move_bytes(const Slice<u8> dst, const Slice<u8> src);
+
+void
+zero_bytes(const Slice<u8> dst);
+
+[[nodiscard]] bool
+equal_bytes(const Slice<u8> a, const Slice<u8> b);
+
+// Up to this many bytes, equal() compares inline instead of calling equal_bytes(). One vector
+// at the widest SIMD width
+constexpr u64 EQUAL_INLINE_MAX = 32;
+
 template <typename T>
 constexpr bool
 equal(const Slice<T> a, const Slice<T> b) {
     if (a.len != b.len) return false;
     if (a.ptr == b.ptr) return true;
 
+    if constexpr (traits::has_unique_object_representations_v<T>) {
+        if (!__builtin_is_constant_evaluated() && a.len * sizeof(T) > EQUAL_INLINE_MAX) {
+            return equal_bytes(
+                Slice<u8>{ (u8*)a.ptr, a.len * sizeof(T) },
+                Slice<u8>{ (u8*)b.ptr, b.len * sizeof(T) }
+            );
+        }
+    }
+
     for (u64 i = 0; i < a.len; ++i) {
         if (a.ptr[i] != b.ptr[i]) return false;
     }
@@ -107,6 +134,67 @@ ends_with(const Slice<T> a, const Slice<T> b) {
     return equal(Slice<T>(a.ptr + a.len - b.len, b.len), b);
 }
 
+// Set of byte values, precomputed once so matching any of several delimiters costs the same as
+// matching one
+struct ByteSet {
+    // Sets up to this size are also kept as a list, which the vectorized scans compare against
+    static constexpr u64 MAX_LISTED = 8;
+
+    u64 bits[4] = {};
+    u8 listed[MAX_LISTED] = {};
+    u8 listed_count = 0;
+    bool overflow = false;
+    bool ready = false;
+
+    static constexpr ByteSet
+    init(const Slice<u8> bytes) {
+        ByteSet set = {};
+        for (u64 i = 0; i < bytes.len; ++i) {
+            const u8 c = bytes.ptr[i];
+            if (set.contains(c)) continue;
+
+            set.bits[c / 64] |= (u64)1 << (c % 64);
+            if (set.listed_count < MAX_LISTED) {
+                set.listed[set.listed_count++] = c;
+            } else {
+                set.overflow = true;
+            }
+        }
+        set.ready = true;
+        return set;
+    }
+
+    constexpr bool
+    contains(const u8 c) const {
+        return (bits[c / 64] >> (c % 64)) & 1;
+    }
+};
+
+// Index of the first byte at or after start that is (or is not) in the set, slice.len if none
+u64
+find_in_set_bytes(const Slice<u8> slice, const u64 start, const ByteSet& set);
+
+u64
+find_not_in_set_bytes(const Slice<u8> slice, const u64 start, const ByteSet& set);
+
+constexpr u64
+find_in_set(const Slice<u8> slice, const u64 start, const ByteSet& set) {
+    if (!__builtin_is_constant_evaluated()) return find_in_set_bytes(slice, start, set);
+
+    u64 idx = start;
+    while (idx < slice.len && !set.contains(slice.ptr[idx])) ++idx;
+    return idx;
+}
+
+constexpr u64
+find_not_in_set(const Slice<u8> slice, const u64 start, const ByteSet& set) {
+    if (!__builtin_is_constant_evaluated()) return find_not_in_set_bytes(slice, start, set);
+
+    u64 idx = start;
+    while (idx < slice.len && set.contains(slice.ptr[idx])) ++idx;
+    return idx;
+}
+
 template <typename T>
 constexpr bool
 is_delimiter(const Slice<T> slice, const Slice<T> delimiter, const u64 index, const bool any) {
@@ -172,9 +260,27 @@ struct TokenIter {
     Slice<T> delimiter;
     u64 index;
     bool any;
+    // Byte delimiters in any mode, built by tokenize() or on first use
+    ByteSet delimiter_set = {};
 
     [[nodiscard]] constexpr bool
     next(Slice<T>* out_value) {
+        if constexpr (traits::is_same_v<T, u8>) {
+            if (any) {
+                if (!delimiter_set.ready) delimiter_set = ByteSet::init(delimiter);
+
+                index = find_not_in_set(buffer, index, delimiter_set);
+                if (index == buffer.len) return false;
+
+                const u64 start = index;
+                index = find_in_set(buffer, start, delimiter_set);
+
+                *out_value = buffer.sub(start, index);
+
+                return true;
+            }
+        }
+
         const u64 len = any ? 1 : delimiter.len;
 
         while (index < buffer.len && is_delimiter(buffer, delimiter, index, any)) {
@@ -205,6 +311,13 @@ struct TokenIter {
         const u64 len = any ? 1 : delimiter.len;
         u64 idx = index;
 
+        if constexpr (traits::is_same_v<T, u8>) {
+            if (any) {
+                const ByteSet set = delimiter_set.ready ? delimiter_set : ByteSet::init(delimiter);
+                idx = find_not_in_set(buffer, idx, set);
+            }
+        }
+
         while (idx < buffer.len && is_delimiter(buffer, delimiter, idx, any)) {
             idx += len;
         }
@@ -223,11 +336,17 @@ struct TokenIter {
 template <typename T>
 TokenIter<T>
 tokenize(const Slice<T> slice, const Slice<T> delimiter, const bool any) {
+    ByteSet delimiter_set = {};
+    if constexpr (traits::is_same_v<T, u8>) {
+        if (any) delimiter_set = ByteSet::init(delimiter);
+    }
+
     return {
         .buffer = slice,
         .delimiter = delimiter,
         .index = 0,
         .any = any,
+        .delimiter_set = delimiter_set,
     };
 }
 
@@ -312,6 +431,8 @@ struct SplitIter {
     Slice<T> delimiter;
     u64 index;
     bool any;
+    // Byte delimiters in any mode, built by split() or on first use
+    ByteSet delimiter_set = {};
 
     [[nodiscard]] constexpr bool
     next(Slice<T>* out_value) {
@@ -321,6 +442,12 @@ struct SplitIter {
 
         const u64 start = index;
         u64 end = start;
+        if constexpr (traits::is_same_v<T, u8>) {
+            if (any) {
+                if (!delimiter_set.ready) delimiter_set = ByteSet::init(delimiter);
+                end = find_in_set(buffer, start, delimiter_set);
+            }
+        }
         while (end < buffer.len && !is_delimiter(buffer, delimiter, end, any)) ++end;
 
         index += end - start;
@@ -341,11 +468,17 @@ struct SplitIter {
 template <typename T>
 SplitIter<T>
 split(const Slice<T> slice, const Slice<T> delimiter, const bool any) {
+    ByteSet delimiter_set = {};
+    if constexpr (traits::is_same_v<T, u8>) {
+        if (any) delimiter_set = ByteSet::init(delimiter);
+    }
+
     return {
         .buffer = slice,
         .delimiter = delimiter,
         .index = 0,
         .any = any,
+        .delimiter_set = delimiter_set,
     };
 }
 
@@ -356,10 +489,149 @@ split_once(const Slice<T> slice, const Slice<T> delimiter, const bool any, Slice
     return it.next(token);
 }
 
+// Delimiter set fixed at compile time, the membership test and the ByteSet handed to the
+// vectorized scans are built from the pack instead of from a delimiter slice
+template <u8... Bytes>
+struct StaticByteSet {
+    static constexpr bool
+    contains(const u8 c) {
+        return ((c == Bytes) || ...);
+    }
+
+    static constexpr u8 BYTES[sizeof...(Bytes) + 1] = { Bytes..., 0 };
+    static constexpr ByteSet SET = ByteSet::init(Slice<u8>{ (u8*)BYTES, sizeof...(Bytes) });
+
+    // Index of the first byte at or after start that is (or is not) in the set, slice.len if none
+    static constexpr u64
+    scan(const Slice<u8> slice, const u64 start, const bool in_set) {
+        return in_set ? find_in_set(slice, start, SET) : find_not_in_set(slice, start, SET);
+    }
+};
+
+template <typename Set>
+struct StaticTokenIter {
+    Slice<u8> buffer;
+    u64 index;
+
+    [[nodiscard]] constexpr bool
+    next(Slice<u8>* out_value) {
+        index = Set::scan(buffer, index, false);
+        if (index == buffer.len) return false;
+
+        const u64 start = index;
+        index = Set::scan(buffer, start, true);
+
+        *out_value = buffer.sub(start, index);
+
+        return true;
+    }
+
+    [[nodiscard]] constexpr bool
+    peek(Slice<u8>* out_value) {
+        auto iter = *this;
+        return iter.next(out_value);
+    }
+
+    [[nodiscard]] constexpr bool
+    to_end(Slice<u8>* out_value) const {
+        const u64 start = Set::scan(buffer, index, false);
+        if (start == buffer.len) return false;
+
+        *out_value = buffer.sub(start, buffer.len);
+
+        return true;
+    }
+};
+
+// Same as tokenize(slice, delimiter, true) with a compile-time delimiter set
+template <typename Set>
+constexpr StaticTokenIter<Set>
+tokenize(const Slice<u8> slice) {
+    return {
+        .buffer = slice,
+        .index = 0,
+    };
+}
+
+template <u8... Delimiters>
+constexpr StaticTokenIter<StaticByteSet<Delimiters...>>
+tokenize(const Slice<u8> slice) {
+    return tokenize<StaticByteSet<Delimiters...>>(slice);
+}
+
+template <typename Set>
+struct StaticSplitIter {
+    Slice<u8> buffer;
+    u64 index;
+
+    [[nodiscard]] constexpr bool
+    next(Slice<u8>* out_value) {
+        if (index == buffer.len) return false;
+
+        const u64 start = index;
+        const u64 end = Set::scan(buffer, start, true);
+
+        index = math::min(buffer.len, end + 1);
+
+        *out_value = buffer.sub(start, end);
+
+        return true;
+    }
+
+    [[nodiscard]] constexpr bool
+    peek(Slice<u8>* out_value) {
+        auto iter = *this;
+        return iter.next(out_value);
+    }
+};
+
+// Same as split(slice, delimiter, true) with a compile-time delimiter set
+template <typename Set>
+constexpr StaticSplitIter<Set>
+split(const Slice<u8> slice) {
+    return {
+        .buffer = slice,
+        .index = 0,
+    };
+}
+
+template <u8... Delimiters>
+constexpr StaticSplitIter<StaticByteSet<Delimiters...>>
+split(const Slice<u8> slice) {
+    return split<StaticByteSet<Delimiters...>>(slice);
+}
+
+// Same as trim(slice, to_trim, true) with a compile-time set
+template <typename Set>
+constexpr Slice<u8>
+trim(const Slice<u8> slice) {
+    const u64 start = Set::scan(slice, 0, false);
+
+    u64 end = slice.len;
+    while (end > start && Set::contains(slice.ptr[end - 1])) --end;
+
+    return slice.sub(start, end);
+}
+
+template <u8... Bytes>
+constexpr Slice<u8>
+trim(const Slice<u8> slice) {
+    return trim<StaticByteSet<Bytes...>>(slice);
+}
+
 using AllocFn = bool (*)(void*, const u64, const u64, Slice<u8>* out_block);
 using ResizeFn =
     bool (*)(void* ctx, void* ptr, const u64 old_size, const u64 new_size, const u64 alignment);
 using FreeFn = void (*)(void* ctx, void* ptr, const u64 size, const u64 alignment);
+// Like ResizeFn, but the allocator may move the block (without copying) and return the new address
+using RemapFn = bool (*)(
+    void* ctx,
+    void* ptr,
+    const u64 old_size,
+    const u64 new_size,
+    const u64 alignment,
+    void** out_ptr
+);
 
 struct Allocator {
     void* ctx;
@@ -368,6 +640,8 @@ struct Allocator {
         AllocFn alloc_fn;
         ResizeFn resize_fn;
         FreeFn free_fn;
+        // Optional, resize_fn is used when null
+        RemapFn remap_fn;
     } vtable;
 
     template <typename T>
@@ -387,6 +661,27 @@ struct Allocator {
         return vtable.resize_fn(ctx, buf.ptr, buf.len * sizeof(T), new_len * sizeof(T), alignof(T));
     }
 
+    // Grows or shrinks buf, possibly moving it. buf is updated on success
+    template <typename T>
+    [[nodiscard]] bool
+    remap(Slice<T>* buf, const u64 new_len) const {
+        if (vtable.remap_fn == nullptr) {
+            if (!resize(*buf, new_len)) return false;
+            buf->len = new_len;
+            return true;
+        }
+
+        void* new_ptr = nullptr;
+        if (!vtable.remap_fn(
+                ctx, buf->ptr, buf->len * sizeof(T), new_len * sizeof(T), alignof(T), &new_ptr
+            ))
+            return false;
+
+        *buf = Slice<T>{ (T*)new_ptr, new_len };
+
+        return true;
+    }
+
     template <typename T>
     void
     free(const Slice<T> buf) const {
@@ -419,21 +714,65 @@ align_up(const T addr, const T alignment) {
 template <typename T>
 constexpr void
 zero(const Slice<T> slice) {
+    if (!__builtin_is_constant_evaluated()) {
+        zero_bytes(Slice<u8>{ (u8*)slice.ptr, slice.len * sizeof(T) });
+        return;
+    }
+
     u8* it = (u8*)slice.ptr;
     for (u64 idx = 0; idx < sizeof(T) * slice.len; ++idx) {
         it[idx] = 0;
     }
 }
 
+// dst and src must not overlap, see move()
 template <typename T>
 constexpr void
 copy(const Slice<T> dst, const Slice<T> src) {
     assert(dst.len == src.len);
+
+    if constexpr (traits::is_trivially_copyable_v<T>) {
+        if (!__builtin_is_constant_evaluated()) {
+            copy_bytes(
+                Slice<u8>{ (u8*)dst.ptr, dst.len * sizeof(T) },
+                Slice<u8>{ (u8*)src.ptr, src.len * sizeof(T) }
+            );
+            return;
+        }
+    }
+
     for (u64 idx = 0; idx < dst.len; ++idx) {
         dst.ptr[idx] = src.ptr[idx];
     }
 }
 
+// Like copy(), but dst and src may overlap
+template <typename T>
+constexpr void
+move(const Slice<T> dst, const Slice<T> src) {
+    assert(dst.len == src.len);
+
+    if constexpr (traits::is_trivially_copyable_v<T>) {
+        if (!__builtin_is_constant_evaluated()) {
+            move_bytes(
+                Slice<u8>{ (u8*)dst.ptr, dst.len * sizeof(T) },
+                Slice<u8>{ (u8*)src.ptr, src.len * sizeof(T) }
+            );
+            return;
+        }
+    }
+
+    if (dst.ptr < src.ptr) {
+        for (u64 idx = 0; idx < dst.len; ++idx) {
+            dst.ptr[idx] = src.ptr[idx];
+        }
+    } else {
+        for (u64 idx = dst.len; idx > 0; --idx) {
+            dst.ptr[idx - 1] = src.ptr[idx - 1];
+        }
+    }
+}
+
 template <typename T>
 [[nodiscard]] bool
 join(const Allocator allocator, Slice<T>* dst, const Slice<T> a, const Slice<T> b) {
@@ -443,17 +782,27 @@ join(const Allocator allocator, Slice<T>* dst, const Slice<T> a, const Slice<T>
     return true;
 }
 
+// Vectorized byte search, Two-Way for long needles. Prefer find()
+[[nodiscard]] bool
+find_bytes(const Slice<u8> haystack, const Slice<u8> needle, u64* out_idx);
+
+// Vectorized byte search from the end, Two-Way on the reversed input for long needles. Prefer
+// find_last()
+[[nodiscard]] bool
+find_last_bytes(const Slice<u8> haystack, const Slice<u8> needle, u64* out_idx);
+
+// Index of the first occurence of needle
 template <typename T>
 constexpr bool
 find(const Slice<T> haystack, const Slice<T> needle, u64* out_idx) {
     if (needle.len > haystack.len) return false;
     if (haystack.len == 0 || needle.len == 0) return false;
-    if (equal(haystack, needle)) {
-        *out_idx = 0;
-        return true;
+
+    if constexpr (traits::is_same_v<T, u8>) {
+        if (!__builtin_is_constant_evaluated()) return find_bytes(haystack, needle, out_idx);
     }
 
-    for (u64 idx = 0; idx < haystack.len - needle.len; ++idx) {
+    for (u64 idx = 0; idx <= haystack.len - needle.len; ++idx) {
         if (equal(Slice{ haystack.ptr + idx, needle.len }, needle)) {
             *out_idx = idx;
             return true;
@@ -463,6 +812,63 @@ find(const Slice<T> haystack, const Slice<T> needle, u64* out_idx) {
     return false;
 }
 
+// Index of the last occurence of needle
+template <typename T>
+constexpr bool
+find_last(const Slice<T> haystack, const Slice<T> needle, u64* out_idx) {
+    if (needle.len > haystack.len) return false;
+    if (haystack.len == 0 || needle.len == 0) return false;
+
+    if constexpr (traits::is_same_v<T, u8>) {
+        if (!__builtin_is_constant_evaluated()) return find_last_bytes(haystack, needle, out_idx);
+    }
+
+    u64 idx = haystack.len - needle.len + 1;
+    while (idx > 0) {
+        --idx;
+        if (equal(Slice{ haystack.ptr + idx, needle.len }, needle)) {
+            *out_idx = idx;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Iterates over the non overlapping occurences of needle
+template <typename T>
+struct FindIter {
+    Slice<T> haystack;
+    Slice<T> needle;
+    u64 index;
+
+    [[nodiscard]] constexpr bool
+    next(u64* out_idx) {
+        if (index >= haystack.len) return false;
+
+        u64 found = 0;
+        if (!find(haystack.at(index), needle, &found)) {
+            index = haystack.len;
+            return false;
+        }
+
+        *out_idx = index + found;
+        index += found + needle.len;
+
+        return true;
+    }
+};
+
+template <typename T>
+constexpr FindIter<T>
+find_all(const Slice<T> haystack, const Slice<T> needle) {
+    return {
+        .haystack = haystack,
+        .needle = needle,
+        .index = 0,
+    };
+}
+
 } // namespace mem
 
 } // namespace mksv
@@ -470,6 +876,8 @@ find(const Slice<T> haystack, const Slice<T> needle, u64* out_idx) {
 using Str = mksv::mem::Slice<u8>;
 
 static const Str WHITESPACE = " \t\v\n\r";
+// WHITESPACE as a compile-time set, for mem::tokenize<WhitespaceSet>(str) and friends
+using WhitespaceSet = mksv::mem::StaticByteSet<' ', '\t', '\v', '\n', '\r'>;
 
 template <u64 size>
 inline Str
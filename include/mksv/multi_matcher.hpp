@@ -0,0 +1,64 @@
+#pragma once
+
+#include "mem.hpp"
+
+namespace mksv {
+namespace mem {
+
+struct MultiMatch {
+    u64 start;
+    u64 end;
+    // Index of the pattern in the slice given to MultiMatcher::init
+    u32 pattern;
+};
+
+struct MultiMatcher;
+
+// Reports every match, overlapping ones included, ordered by end offset
+struct MultiMatchIter {
+    const MultiMatcher* matcher;
+    Str haystack;
+    u64 index;
+    u32 state;
+    // Matches ending at index not reported yet
+    u32 output_state;
+    u32 output_pattern;
+
+    [[nodiscard]] bool
+    next(MultiMatch* out_match);
+};
+
+// Aho-Corasick automaton compiled to a DFA, so a haystack is scanned once for all the patterns.
+// Bytes that appear in no pattern share a single class, the transition table only has a column
+// per byte class
+struct MultiMatcher {
+    static constexpr u32 NONE = 0xFFFF'FFFF;
+    // Set on transitions to states that have matches to report
+    static constexpr u32 OUTPUT_FLAG = 0x8000'0000;
+
+    Allocator allocator;
+    u16 byte_class[256];
+    u32 class_count;
+    u32 state_count;
+    // state_count rows of class_count targets
+    Slice<u32> transitions;
+    // Last pattern inserted ending at the state, others follow through next_pattern
+    Slice<u32> state_pattern;
+    // Closest state reachable through failure links that has a pattern
+    Slice<u32> output_link;
+    Slice<u32> next_pattern;
+    Slice<u64> pattern_len;
+
+    // Empty patterns never match
+    [[nodiscard]] static bool
+    init(const Allocator allocator, const Slice<Str> patterns, MultiMatcher* out_matcher);
+
+    void
+    deinit();
+
+    MultiMatchIter
+    matches(const Str haystack) const;
+};
+
+} // namespace mem
+} // namespace mksv
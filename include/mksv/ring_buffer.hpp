@@ -0,0 +1,44 @@
+#pragma once
+
+#include "mem.hpp"
+
+namespace mksv {
+
+// Byte ring buffer whose storage is mapped twice back to back, so the readable and writable
+// regions are always one contiguous slice, even across the wraparound
+struct RingBuffer {
+    // First of the two mappings, buffer.len is the capacity
+    mem::Slice<u8> buffer;
+    u64 read_idx;
+    u64 size;
+
+    // Capacity is rounded up to the OS allocation granularity
+    [[nodiscard]] static bool
+    init(const u64 min_capacity, RingBuffer* out_ring);
+
+    void
+    deinit();
+
+    // Bytes written and not consumed yet
+    Str
+    readable() const;
+
+    // Free space, fill it then call commit()
+    Str
+    writable() const;
+
+    void
+    commit(const u64 len);
+
+    void
+    consume(const u64 len);
+
+    // Copies data in, fails if it doesn't fit
+    [[nodiscard]] bool
+    write(const Str data);
+
+    void
+    clear();
+};
+
+} // namespace mksv
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "bit.hpp"
+#include "ctx.hpp"
+#include "mem.hpp"
+
+namespace mksv {
+namespace mem {
+
+// Index of the first element of sorted that is not less than value, sorted.len if none. The loop
+// always runs log2(len) times and only selects the next base, which compiles to a conditional move
+// instead of a branch the predictor can't learn
+template <typename T, typename Less>
+u64
+lower_bound(const Slice<T> sorted, const T& value, Less less) {
+    if (sorted.len == 0) return 0;
+
+    const T* base = sorted.ptr;
+    u64 len = sorted.len;
+    while (len > 1) {
+        const u64 half = len / 2;
+        // Both possible next midpoints, the loads overlap with the comparison instead of waiting
+        // on it
+#if COMPILER_CLANG || COMPILER_GCC
+        __builtin_prefetch(base + half / 2);
+        __builtin_prefetch(base + half + half / 2);
+#endif
+        base = less(base[half], value) ? base + half : base;
+        len -= half;
+    }
+
+    return (u64)(base - sorted.ptr) + less(*base, value);
+}
+
+template <typename T>
+u64
+lower_bound(const Slice<T> sorted, const T& value) {
+    return lower_bound(sorted, value, [](const T& a, const T& b) { return a < b; });
+}
+
+// Index of the first element of sorted that is greater than value, sorted.len if none
+template <typename T, typename Less>
+u64
+upper_bound(const Slice<T> sorted, const T& value, Less less) {
+    if (sorted.len == 0) return 0;
+
+    const T* base = sorted.ptr;
+    u64 len = sorted.len;
+    while (len > 1) {
+        const u64 half = len / 2;
+#if COMPILER_CLANG || COMPILER_GCC
+        __builtin_prefetch(base + half / 2);
+        __builtin_prefetch(base + half + half / 2);
+#endif
+        base = !less(value, base[half]) ? base + half : base;
+        len -= half;
+    }
+
+    return (u64)(base - sorted.ptr) + !less(value, *base);
+}
+
+template <typename T>
+u64
+upper_bound(const Slice<T> sorted, const T& value) {
+    return upper_bound(sorted, value, [](const T& a, const T& b) { return a < b; });
+}
+
+// Eytzinger layout stores a sorted array as a complete binary tree in breadth first order, node k
+// (1-based) has its children at 2k and 2k + 1. A search walks down from the root, so the next few
+// levels sit in consecutive memory and can be prefetched while the current one is compared
+template <typename T>
+u64
+eytzinger_fill(const Slice<T> sorted, const Slice<T> out, u64 sorted_idx, const u64 node) {
+    if (node > out.len) return sorted_idx;
+
+    sorted_idx = eytzinger_fill(sorted, out, sorted_idx, 2 * node);
+    out.ptr[node - 1] = sorted.ptr[sorted_idx++];
+    return eytzinger_fill(sorted, out, sorted_idx, 2 * node + 1);
+}
+
+// out must have the same length as sorted
+template <typename T>
+void
+eytzinger_from_sorted(const Slice<T> sorted, const Slice<T> out) {
+    assert(out.len == sorted.len);
+    eytzinger_fill(sorted, out, 0, 1);
+}
+
+// Index in layout of the first element not less than value, layout.len if none
+template <typename T, typename Less>
+u64
+eytzinger_lower_bound(const Slice<T> layout, const T& value, Less less) {
+    // Nodes per cache line, the descendants of node k that far down start at k * prefetch_stride
+    constexpr u64 prefetch_stride = sizeof(T) >= 64 ? 1 : 64 / sizeof(T);
+
+    u64 node = 1;
+    while (node <= layout.len) {
+#if COMPILER_CLANG || COMPILER_GCC
+        __builtin_prefetch((const u8*)layout.ptr + (node * prefetch_stride - 1) * sizeof(T));
+#endif
+        node = 2 * node + less(layout.ptr[node - 1], value);
+    }
+
+    // Each step right appended a 1 bit, the answer is where the path last went left
+    node >>= bit::ctz(~node) + 1;
+
+    return node == 0 ? layout.len : node - 1;
+}
+
+template <typename T>
+u64
+eytzinger_lower_bound(const Slice<T> layout, const T& value) {
+    return eytzinger_lower_bound(layout, value, [](const T& a, const T& b) { return a < b; });
+}
+
+} // namespace mem
+} // namespace mksv
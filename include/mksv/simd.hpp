@@ -0,0 +1,228 @@
+#pragma once
+
+#include "ctx.hpp"
+#include "types.hpp"
+
+#if ARCH_X64
+#include <immintrin.h>
+#endif
+
+namespace mksv {
+namespace simd {
+
+// Thin wrapper over the widest byte vector the target is compiled for. Only available on x64,
+// callers keep a scalar path for the other architectures. SIMD_LOOKUP is defined when byte
+// shuffles (table16, lookup16) are available. Otherwise, on clang and gcc, SIMD_LOOKUP_DISPATCH
+// is defined: the shuffles are compiled for SSSE3 anyway, callers mark their functions
+// SIMD_LOOKUP_TARGET and only call them when has_lookup() is true at run time
+#if ARCH_X64
+#ifdef __AVX2__
+
+constexpr u64 WIDTH = 32;
+constexpr u32 FULL_MASK = 0xFFFF'FFFF;
+using U8x = __m256i;
+
+inline U8x
+load(const u8* ptr) {
+    return _mm256_loadu_si256((const __m256i*)ptr);
+}
+
+inline void
+store(u8* ptr, const U8x v) {
+    _mm256_storeu_si256((__m256i*)ptr, v);
+}
+
+// Bypasses the cache, ptr must be aligned to WIDTH
+inline void
+store_stream(u8* ptr, const U8x v) {
+    _mm256_stream_si256((__m256i*)ptr, v);
+}
+
+inline U8x
+zero() {
+    return _mm256_setzero_si256();
+}
+
+inline U8x
+splat(const u8 c) {
+    return _mm256_set1_epi8((char)c);
+}
+
+inline U8x
+cmpeq(const U8x a, const U8x b) {
+    return _mm256_cmpeq_epi8(a, b);
+}
+
+inline U8x
+bit_and(const U8x a, const U8x b) {
+    return _mm256_and_si256(a, b);
+}
+
+inline U8x
+bit_or(const U8x a, const U8x b) {
+    return _mm256_or_si256(a, b);
+}
+
+// One bit per byte, set when the byte's high bit is set
+inline u32
+movemask(const U8x v) {
+    return (u32)_mm256_movemask_epi8(v);
+}
+
+inline U8x
+bit_xor(const U8x a, const U8x b) {
+    return _mm256_xor_si256(a, b);
+}
+
+// Per byte a - b, clamped to 0
+inline U8x
+sub_saturate(const U8x a, const U8x b) {
+    return _mm256_subs_epu8(a, b);
+}
+
+// Per byte shift, the high bits are cleared
+inline U8x
+shift_right4(const U8x v) {
+    return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+}
+
+// Bytes of v shifted up by N, with the last N bytes of prev shifted in
+template <u32 N>
+inline U8x
+prev(const U8x v, const U8x prev) {
+    return _mm256_alignr_epi8(v, _mm256_permute2x128_si256(prev, v, 0x21), 16 - N);
+}
+
+#define SIMD_LOOKUP 1
+#define SIMD_LOOKUP_TARGET
+
+// Table of 16 bytes, repeated as needed by lookup16()
+inline U8x
+table16(const u8* table) {
+    return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)table));
+}
+
+// Per byte table[idx], idx must be in [0, 16)
+inline U8x
+lookup16(const U8x table, const U8x idx) {
+    return _mm256_shuffle_epi8(table, idx);
+}
+
+#else
+
+constexpr u64 WIDTH = 16;
+constexpr u32 FULL_MASK = 0xFFFF;
+using U8x = __m128i;
+
+inline U8x
+load(const u8* ptr) {
+    return _mm_loadu_si128((const __m128i*)ptr);
+}
+
+inline void
+store(u8* ptr, const U8x v) {
+    _mm_storeu_si128((__m128i*)ptr, v);
+}
+
+// Bypasses the cache, ptr must be aligned to WIDTH
+inline void
+store_stream(u8* ptr, const U8x v) {
+    _mm_stream_si128((__m128i*)ptr, v);
+}
+
+inline U8x
+zero() {
+    return _mm_setzero_si128();
+}
+
+inline U8x
+splat(const u8 c) {
+    return _mm_set1_epi8((char)c);
+}
+
+inline U8x
+cmpeq(const U8x a, const U8x b) {
+    return _mm_cmpeq_epi8(a, b);
+}
+
+inline U8x
+bit_and(const U8x a, const U8x b) {
+    return _mm_and_si128(a, b);
+}
+
+inline U8x
+bit_or(const U8x a, const U8x b) {
+    return _mm_or_si128(a, b);
+}
+
+// One bit per byte, set when the byte's high bit is set
+inline u32
+movemask(const U8x v) {
+    return (u32)_mm_movemask_epi8(v);
+}
+
+inline U8x
+bit_xor(const U8x a, const U8x b) {
+    return _mm_xor_si128(a, b);
+}
+
+// Per byte a - b, clamped to 0
+inline U8x
+sub_saturate(const U8x a, const U8x b) {
+    return _mm_subs_epu8(a, b);
+}
+
+// Per byte shift, the high bits are cleared
+inline U8x
+shift_right4(const U8x v) {
+    return _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0F));
+}
+
+// Bytes of v shifted up by N, with the last N bytes of prev shifted in
+template <u32 N>
+inline U8x
+prev(const U8x v, const U8x prev) {
+    return _mm_or_si128(_mm_slli_si128(v, N), _mm_srli_si128(prev, 16 - N));
+}
+
+// Byte shuffles need SSSE3
+#ifdef __SSSE3__
+#define SIMD_LOOKUP 1
+#define SIMD_LOOKUP_TARGET
+#elif COMPILER_CLANG || COMPILER_GCC
+#define SIMD_LOOKUP_DISPATCH 1
+#define SIMD_LOOKUP_TARGET __attribute__((target("ssse3")))
+
+inline bool
+has_lookup() {
+    static const bool supported = __builtin_cpu_supports("ssse3");
+    return supported;
+}
+#endif
+
+#if SIMD_LOOKUP || SIMD_LOOKUP_DISPATCH
+// Table of 16 bytes, repeated as needed by lookup16()
+SIMD_LOOKUP_TARGET inline U8x
+table16(const u8* table) {
+    return _mm_loadu_si128((const __m128i*)table);
+}
+
+// Per byte table[idx], idx must be in [0, 16)
+SIMD_LOOKUP_TARGET inline U8x
+lookup16(const U8x table, const U8x idx) {
+    return _mm_shuffle_epi8(table, idx);
+}
+#endif
+
+#endif
+
+// Orders streaming stores before the following stores
+inline void
+store_fence() {
+    _mm_sfence();
+}
+
+#endif
+
+} // namespace simd
+} // namespace mksv
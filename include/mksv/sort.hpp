@@ -0,0 +1,693 @@
+#pragma once
+
+#include "bit.hpp"
+#include "mem.hpp"
+#include "thread.hpp"
+#include "type_traits.hpp"
+#include "utils.hpp"
+
+namespace mksv {
+namespace mem {
+
+// Pattern-defeating quicksort (Orson Peters). Quicksort with median of 3 (ninther on large
+// partitions) pivots, insertion sort on small partitions, a pass that detects already sorted
+// partitions, shuffles that break adversarial patterns and a heapsort fallback that bounds the
+// worst case to O(n log n). Not stable
+constexpr u64 PDQ_INSERTION_SORT_THRESHOLD = 24;
+constexpr u64 PDQ_NINTHER_THRESHOLD = 128;
+constexpr u64 PDQ_PARTIAL_INSERTION_SORT_LIMIT = 8;
+constexpr u64 PDQ_BLOCK_SIZE = 64;
+
+template <typename T>
+inline void
+swap(T* a, T* b) {
+    T tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+template <typename T, typename Less>
+inline void
+pdq_insertion_sort(T* begin, T* end, Less& less) {
+    if (begin == end) return;
+
+    for (T* cur = begin + 1; cur != end; ++cur) {
+        T* sift = cur;
+        T* sift_1 = cur - 1;
+
+        if (less(*sift, *sift_1)) {
+            T tmp = *sift;
+            do {
+                *sift-- = *sift_1;
+            } while (sift != begin && less(tmp, *--sift_1));
+            *sift = tmp;
+        }
+    }
+}
+
+// Assumes *(begin - 1) is not greater than any element of the range
+template <typename T, typename Less>
+inline void
+pdq_unguarded_insertion_sort(T* begin, T* end, Less& less) {
+    if (begin == end) return;
+
+    for (T* cur = begin + 1; cur != end; ++cur) {
+        T* sift = cur;
+        T* sift_1 = cur - 1;
+
+        if (less(*sift, *sift_1)) {
+            T tmp = *sift;
+            do {
+                *sift-- = *sift_1;
+            } while (less(tmp, *--sift_1));
+            *sift = tmp;
+        }
+    }
+}
+
+// Gives up once more than PDQ_PARTIAL_INSERTION_SORT_LIMIT elements were moved, returns whether
+// the range got sorted
+template <typename T, typename Less>
+inline bool
+pdq_partial_insertion_sort(T* begin, T* end, Less& less) {
+    if (begin == end) return true;
+
+    u64 moved = 0;
+    for (T* cur = begin + 1; cur != end; ++cur) {
+        T* sift = cur;
+        T* sift_1 = cur - 1;
+
+        if (less(*sift, *sift_1)) {
+            T tmp = *sift;
+            do {
+                *sift-- = *sift_1;
+            } while (sift != begin && less(tmp, *--sift_1));
+            *sift = tmp;
+            moved += (u64)(cur - sift);
+        }
+
+        if (moved > PDQ_PARTIAL_INSERTION_SORT_LIMIT) return false;
+    }
+
+    return true;
+}
+
+template <typename T, typename Less>
+inline void
+pdq_sort2(T* a, T* b, Less& less) {
+    if (less(*b, *a)) swap(a, b);
+}
+
+template <typename T, typename Less>
+inline void
+pdq_sort3(T* a, T* b, T* c, Less& less) {
+    pdq_sort2(a, b, less);
+    pdq_sort2(b, c, less);
+    pdq_sort2(a, b, less);
+}
+
+template <typename T, typename Less>
+inline void
+pdq_sift_down(T* begin, u64 root, const u64 len, Less& less) {
+    const T value = begin[root];
+    for (;;) {
+        u64 child = 2 * root + 1;
+        if (child >= len) break;
+        if (child + 1 < len && less(begin[child], begin[child + 1])) ++child;
+        if (!less(value, begin[child])) break;
+        begin[root] = begin[child];
+        root = child;
+    }
+    begin[root] = value;
+}
+
+template <typename T, typename Less>
+inline void
+pdq_heap_sort(T* begin, T* end, Less& less) {
+    const u64 len = (u64)(end - begin);
+    if (len < 2) return;
+
+    for (u64 i = len / 2; i > 0; --i) pdq_sift_down(begin, i - 1, len, less);
+    for (u64 i = len - 1; i > 0; --i) {
+        swap(begin, begin + i);
+        pdq_sift_down(begin, 0, i, less);
+    }
+}
+
+// Swaps the elements flagged by the partition blocks. Rotating through a temporary does one copy
+// per element instead of three, but only works when both sides have the same count
+template <typename T>
+inline void
+pdq_swap_offsets(
+    T* first,
+    T* last,
+    const u8* offsets_l,
+    const u8* offsets_r,
+    const u64 count,
+    const bool use_swaps
+) {
+    if (use_swaps) {
+        for (u64 i = 0; i < count; ++i) swap(first + offsets_l[i], last - offsets_r[i]);
+    } else if (count > 0) {
+        T* l = first + offsets_l[0];
+        T* r = last - offsets_r[0];
+        T tmp = *l;
+        *l = *r;
+        for (u64 i = 1; i < count; ++i) {
+            l = first + offsets_l[i];
+            *r = *l;
+            r = last - offsets_r[i];
+            *l = *r;
+        }
+        *r = tmp;
+    }
+}
+
+struct PdqPartition {
+    u64 pivot;
+    bool already_partitioned;
+};
+
+// Partitions around *begin, elements equal to the pivot go to the right. Elements are compared a
+// block at a time and only their offsets are recorded, so the comparisons don't branch
+template <typename T, typename Less>
+inline PdqPartition
+pdq_partition_right_branchless(T* begin, T* end, Less& less) {
+    const T pivot = *begin;
+    T* first = begin;
+    T* last = end;
+
+    // The median of 3 guarantees an element >= pivot on the right and one < pivot on the left
+    // (unless begin is the leftmost element)
+    while (less(*++first, pivot));
+
+    if (first - 1 == begin) {
+        while (first < last && !less(*--last, pivot));
+    } else {
+        while (!less(*--last, pivot));
+    }
+
+    const bool already_partitioned = first >= last;
+    if (!already_partitioned) {
+        swap(first, last);
+        ++first;
+
+        alignas(64) u8 offsets_l[PDQ_BLOCK_SIZE];
+        alignas(64) u8 offsets_r[PDQ_BLOCK_SIZE];
+
+        T* offsets_l_base = first;
+        T* offsets_r_base = last;
+        u64 num_l = 0;
+        u64 num_r = 0;
+        u64 start_l = 0;
+        u64 start_r = 0;
+
+        while (first < last) {
+            const u64 num_unknown = (u64)(last - first);
+            const u64 left_split = num_l == 0 ? (num_r == 0 ? num_unknown / 2 : num_unknown) : 0;
+            const u64 right_split = num_r == 0 ? (num_unknown - left_split) : 0;
+
+            const u64 left_count = math::min(left_split, PDQ_BLOCK_SIZE);
+            for (u64 i = 0; i < left_count; ++i) {
+                offsets_l[num_l] = (u8)i;
+                num_l += !less(*first, pivot);
+                ++first;
+            }
+
+            const u64 right_count = math::min(right_split, PDQ_BLOCK_SIZE);
+            for (u64 i = 0; i < right_count;) {
+                offsets_r[num_r] = (u8)++i;
+                num_r += less(*--last, pivot);
+            }
+
+            const u64 count = math::min(num_l, num_r);
+            pdq_swap_offsets(
+                offsets_l_base,
+                offsets_r_base,
+                offsets_l + start_l,
+                offsets_r + start_r,
+                count,
+                num_l == num_r
+            );
+            num_l -= count;
+            num_r -= count;
+            start_l += count;
+            start_r += count;
+
+            if (num_l == 0) {
+                start_l = 0;
+                offsets_l_base = first;
+            }
+            if (num_r == 0) {
+                start_r = 0;
+                offsets_r_base = last;
+            }
+        }
+
+        // One side has leftover elements, move them next to the pivot's final position
+        if (num_l != 0) {
+            while (num_l != 0) {
+                --num_l;
+                swap(offsets_l_base + offsets_l[start_l + num_l], --last);
+            }
+            first = last;
+        }
+        if (num_r != 0) {
+            while (num_r != 0) {
+                --num_r;
+                swap(offsets_r_base - offsets_r[start_r + num_r], first);
+                ++first;
+            }
+        }
+    }
+
+    T* pivot_pos = first - 1;
+    *begin = *pivot_pos;
+    *pivot_pos = pivot;
+
+    return { .pivot = (u64)(pivot_pos - begin), .already_partitioned = already_partitioned };
+}
+
+template <typename T, typename Less>
+inline PdqPartition
+pdq_partition_right(T* begin, T* end, Less& less) {
+    const T pivot = *begin;
+    T* first = begin;
+    T* last = end;
+
+    while (less(*++first, pivot));
+
+    if (first - 1 == begin) {
+        while (first < last && !less(*--last, pivot));
+    } else {
+        while (!less(*--last, pivot));
+    }
+
+    const bool already_partitioned = first >= last;
+    while (first < last) {
+        swap(first, last);
+        while (less(*++first, pivot));
+        while (!less(*--last, pivot));
+    }
+
+    T* pivot_pos = first - 1;
+    *begin = *pivot_pos;
+    *pivot_pos = pivot;
+
+    return { .pivot = (u64)(pivot_pos - begin), .already_partitioned = already_partitioned };
+}
+
+// Partitions around *begin with elements equal to the pivot on the left. Used when the pivot equals
+// the element before the range, the whole left side is then equal and needs no more sorting
+template <typename T, typename Less>
+inline T*
+pdq_partition_left(T* begin, T* end, Less& less) {
+    const T pivot = *begin;
+    T* first = begin;
+    T* last = end;
+
+    while (less(pivot, *--last));
+
+    if (last + 1 == end) {
+        while (first < last && !less(pivot, *++first));
+    } else {
+        while (!less(pivot, *++first));
+    }
+
+    while (first < last) {
+        swap(first, last);
+        while (less(pivot, *--last));
+        while (!less(pivot, *++first));
+    }
+
+    T* pivot_pos = last;
+    *begin = *pivot_pos;
+    *pivot_pos = pivot;
+
+    return pivot_pos;
+}
+
+template <bool branchless, typename T, typename Less>
+inline void
+pdq_loop(T* begin, T* end, Less& less, u32 bad_allowed, bool leftmost) {
+    for (;;) {
+        const u64 size = (u64)(end - begin);
+
+        if (size < PDQ_INSERTION_SORT_THRESHOLD) {
+            if (leftmost) {
+                pdq_insertion_sort(begin, end, less);
+            } else {
+                pdq_unguarded_insertion_sort(begin, end, less);
+            }
+            return;
+        }
+
+        // Pivot goes to *begin
+        const u64 s2 = size / 2;
+        if (size > PDQ_NINTHER_THRESHOLD) {
+            pdq_sort3(begin, begin + s2, end - 1, less);
+            pdq_sort3(begin + 1, begin + (s2 - 1), end - 2, less);
+            pdq_sort3(begin + 2, begin + (s2 + 1), end - 3, less);
+            pdq_sort3(begin + (s2 - 1), begin + s2, begin + (s2 + 1), less);
+            swap(begin, begin + s2);
+        } else {
+            pdq_sort3(begin + s2, begin, end - 1, less);
+        }
+
+        // Same pivot as the parent partition, everything equal to it goes left and is done
+        if (!leftmost && !less(*(begin - 1), *begin)) {
+            begin = pdq_partition_left(begin, end, less) + 1;
+            continue;
+        }
+
+        const PdqPartition part = branchless ? pdq_partition_right_branchless(begin, end, less)
+                                             : pdq_partition_right(begin, end, less);
+        T* pivot_pos = begin + part.pivot;
+
+        const u64 l_size = (u64)(pivot_pos - begin);
+        const u64 r_size = (u64)(end - (pivot_pos + 1));
+        const bool highly_unbalanced = l_size < size / 8 || r_size < size / 8;
+
+        if (highly_unbalanced) {
+            if (--bad_allowed == 0) {
+                pdq_heap_sort(begin, end, less);
+                return;
+            }
+
+            if (l_size >= PDQ_INSERTION_SORT_THRESHOLD) {
+                swap(begin, begin + l_size / 4);
+                swap(pivot_pos - 1, pivot_pos - l_size / 4);
+
+                if (l_size > PDQ_NINTHER_THRESHOLD) {
+                    swap(begin + 1, begin + (l_size / 4 + 1));
+                    swap(begin + 2, begin + (l_size / 4 + 2));
+                    swap(pivot_pos - 2, pivot_pos - (l_size / 4 + 1));
+                    swap(pivot_pos - 3, pivot_pos - (l_size / 4 + 2));
+                }
+            }
+
+            if (r_size >= PDQ_INSERTION_SORT_THRESHOLD) {
+                swap(pivot_pos + 1, pivot_pos + (1 + r_size / 4));
+                swap(end - 1, end - r_size / 4);
+
+                if (r_size > PDQ_NINTHER_THRESHOLD) {
+                    swap(pivot_pos + 2, pivot_pos + (2 + r_size / 4));
+                    swap(pivot_pos + 3, pivot_pos + (3 + r_size / 4));
+                    swap(end - 2, end - (1 + r_size / 4));
+                    swap(end - 3, end - (2 + r_size / 4));
+                }
+            }
+        } else if (part.already_partitioned &&
+                   pdq_partial_insertion_sort(begin, pivot_pos, less) &&
+                   pdq_partial_insertion_sort(pivot_pos + 1, end, less)) {
+            // Probably already sorted
+            return;
+        }
+
+        // Recurse on the left, loop on the right
+        pdq_loop<branchless>(begin, pivot_pos, less, bad_allowed, leftmost);
+        begin = pivot_pos + 1;
+        leftmost = false;
+    }
+}
+
+// Sorts in place with less(a, b) as the strict weak ordering
+template <typename T, typename Less>
+void
+sort(const Slice<T> slice, Less less) {
+    if (slice.len < 2) return;
+
+    // Block partitioning copies elements around, it only pays off for cheap to copy types
+    constexpr bool branchless = traits::is_trivially_copyable_v<T> && sizeof(T) <= 16;
+    pdq_loop<branchless>(slice.ptr, slice.ptr + slice.len, less, bit::log2(slice.len), true);
+}
+
+template <typename T>
+void
+sort(const Slice<T> slice) {
+    sort(slice, [](const T& a, const T& b) { return a < b; });
+}
+
+// Below this many elements per thread, parallel_sort() sorts on the calling thread
+constexpr u64 PARALLEL_SORT_MIN_CHUNK = 1 << 16;
+
+template <typename T, typename Less>
+struct ParallelSort {
+    Less* less;
+    u64 chunk_size;
+    u64 task_count;
+    // Merge round state, runs of run_size elements are merged pairwise from src to dst
+    T* src;
+    T* dst;
+    u64 len;
+    u64 run_size;
+    u64 tasks_per_pair;
+};
+
+// Number of elements of a that come before the first d elements of the merge of a and b (merge
+// path). Elements of a go first on ties
+template <typename T, typename Less>
+inline u64
+merge_split(const T* a, const u64 a_len, const T* b, const u64 b_len, const u64 d, Less& less) {
+    u64 lo = d > b_len ? d - b_len : 0;
+    u64 hi = math::min(d, a_len);
+    while (lo < hi) {
+        const u64 mid = lo + (hi - lo) / 2;
+        if (!less(b[d - mid - 1], a[mid])) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+template <typename T, typename Less>
+void
+parallel_sort_chunk(void* ctx, const u32 task_index) {
+    const ParallelSort<T, Less>* ps = (const ParallelSort<T, Less>*)ctx;
+
+    const u64 start = math::min(ps->len, task_index * ps->chunk_size);
+    const u64 end = math::min(ps->len, start + ps->chunk_size);
+    sort(Slice<T>{ ps->src + start, end - start }, *ps->less);
+}
+
+template <typename T, typename Less>
+void
+parallel_sort_merge(void* ctx, const u32 task_index) {
+    const ParallelSort<T, Less>* ps = (const ParallelSort<T, Less>*)ctx;
+    Less& less = *ps->less;
+
+    const u64 pair = task_index / ps->tasks_per_pair;
+    const u64 piece = task_index % ps->tasks_per_pair;
+
+    const u64 pair_start = math::min(ps->len, pair * 2 * ps->run_size);
+    const u64 pair_mid = math::min(ps->len, pair_start + ps->run_size);
+    const u64 pair_end = math::min(ps->len, pair_mid + ps->run_size);
+
+    const T* a = ps->src + pair_start;
+    const u64 a_len = pair_mid - pair_start;
+    const T* b = ps->src + pair_mid;
+    const u64 b_len = pair_end - pair_mid;
+
+    // Every task of the pair writes an equal share of its output
+    const u64 out_len = a_len + b_len;
+    const u64 d0 = out_len * piece / ps->tasks_per_pair;
+    const u64 d1 = out_len * (piece + 1) / ps->tasks_per_pair;
+
+    u64 i = merge_split(a, a_len, b, b_len, d0, less);
+    u64 j = d0 - i;
+    const u64 i_end = merge_split(a, a_len, b, b_len, d1, less);
+    const u64 j_end = d1 - i_end;
+
+    T* out = ps->dst + pair_start + d0;
+    while (i < i_end && j < j_end) {
+        if (less(b[j], a[i])) {
+            *out++ = b[j++];
+        } else {
+            *out++ = a[i++];
+        }
+    }
+    while (i < i_end) *out++ = a[i++];
+    while (j < j_end) *out++ = b[j++];
+}
+
+// Sorts chunks on up to thread_count threads (0 means one per cpu) with sort(), then merges them
+// pairwise. Each merge round splits the merges with merge_split() so every thread has an equal
+// share of the output. The scratch buffer (slice.len elements) comes from allocator. Not stable
+template <typename T, typename Less>
+[[nodiscard]] bool
+parallel_sort(const Allocator allocator, const Slice<T> slice, const u32 thread_count, Less less) {
+    static_assert(traits::is_trivially_copyable_v<T>, "Elements are copied to scratch memory");
+
+    u64 task_count = thread_count == 0 ? thread::cpu_count() : thread_count;
+    task_count = math::min(task_count, (u64)thread::MAX_TASKS);
+    task_count = math::min(task_count, slice.len / PARALLEL_SORT_MIN_CHUNK);
+    if (task_count <= 1) {
+        sort(slice, less);
+        return true;
+    }
+
+    Slice<T> scratch = {};
+    if (!allocator.alloc(slice.len, &scratch)) return false;
+    defer(allocator.free(scratch));
+
+    ParallelSort<T, Less> ps = {
+        .less = &less,
+        .chunk_size = (slice.len + task_count - 1) / task_count,
+        .task_count = task_count,
+        .src = slice.ptr,
+        .dst = scratch.ptr,
+        .len = slice.len,
+        .run_size = 0,
+        .tasks_per_pair = 0,
+    };
+
+    thread::run_parallel((u32)task_count, parallel_sort_chunk<T, Less>, &ps);
+
+    for (ps.run_size = ps.chunk_size; ps.run_size < ps.len; ps.run_size *= 2) {
+        const u64 pair_count = (ps.len + 2 * ps.run_size - 1) / (2 * ps.run_size);
+        ps.tasks_per_pair = math::max((u64)1, task_count / pair_count);
+
+        thread::run_parallel(
+            (u32)(pair_count * ps.tasks_per_pair), parallel_sort_merge<T, Less>, &ps
+        );
+
+        swap(&ps.src, &ps.dst);
+    }
+
+    if (ps.src != slice.ptr) copy(slice, Slice<T>{ ps.src, slice.len });
+
+    return true;
+}
+
+template <typename T>
+[[nodiscard]] bool
+parallel_sort(const Allocator allocator, const Slice<T> slice, const u32 thread_count) {
+    return parallel_sort(allocator, slice, thread_count, [](const T& a, const T& b) {
+        return a < b;
+    });
+}
+
+// Radix sort keys, unsigned integers that order the same way as the values they come from
+inline u32
+radix_key(const u32 x) {
+    return x;
+}
+
+inline u64
+radix_key(const u64 x) {
+    return x;
+}
+
+// Negative floats have every bit flipped, positive ones only the sign bit. -NaN sorts first and
+// NaN last
+inline u32
+radix_key(const f32 x) {
+    const u32 bits = __builtin_bit_cast(u32, x);
+    return (bits & 0x8000'0000) ? ~bits : bits | 0x8000'0000;
+}
+
+constexpr u32 RADIX_DIGIT_BITS = 11;
+constexpr u64 RADIX_DIGIT_COUNT = 1 << RADIX_DIGIT_BITS;
+// Below this, the histograms cost more than a comparison sort
+constexpr u64 RADIX_MIN_LEN = 256;
+
+// LSD radix sort on 11 bit digits, stable. Histograms for every digit are built in a single pass,
+// passes where every key has the same digit are skipped. values is either empty or moved along with
+// keys
+template <typename K, typename V>
+[[nodiscard]] bool
+radix_sort_impl(const Allocator allocator, const Slice<K> keys, const Slice<V> values) {
+    assert(values.len == 0 || values.len == keys.len);
+
+    using Key = decltype(radix_key(K{}));
+    constexpr u32 pass_count = (sizeof(Key) * 8 + RADIX_DIGIT_BITS - 1) / RADIX_DIGIT_BITS;
+    constexpr Key digit_mask = RADIX_DIGIT_COUNT - 1;
+
+    const u64 len = keys.len;
+    if (len < 2) return true;
+
+    const bool has_values = values.len != 0;
+
+    Slice<u64> counts = {};
+    if (!allocator.alloc(pass_count * RADIX_DIGIT_COUNT, &counts)) return false;
+    defer(allocator.free(counts));
+    zero(counts);
+
+    Slice<K> key_scratch = {};
+    if (!allocator.alloc(len, &key_scratch)) return false;
+    defer(allocator.free(key_scratch));
+
+    Slice<V> value_scratch = {};
+    if (has_values) {
+        if (!allocator.alloc(len, &value_scratch)) return false;
+    }
+    defer(if (value_scratch.ptr != nullptr) allocator.free(value_scratch));
+
+    for (u64 i = 0; i < len; ++i) {
+        const Key key = radix_key(keys.ptr[i]);
+        for (u32 pass = 0; pass < pass_count; ++pass) {
+            const Key digit = (key >> (pass * RADIX_DIGIT_BITS)) & digit_mask;
+            ++counts.ptr[pass * RADIX_DIGIT_COUNT + digit];
+        }
+    }
+
+    K* src_keys = keys.ptr;
+    K* dst_keys = key_scratch.ptr;
+    V* src_values = values.ptr;
+    V* dst_values = value_scratch.ptr;
+
+    for (u32 pass = 0; pass < pass_count; ++pass) {
+        const u32 shift = pass * RADIX_DIGIT_BITS;
+        u64* offsets = counts.ptr + pass * RADIX_DIGIT_COUNT;
+
+        // Every key lands in the same bucket, nothing would move
+        const Key first_digit = (radix_key(src_keys[0]) >> shift) & digit_mask;
+        if (offsets[first_digit] == len) continue;
+
+        u64 sum = 0;
+        for (u64 d = 0; d < RADIX_DIGIT_COUNT; ++d) {
+            const u64 count = offsets[d];
+            offsets[d] = sum;
+            sum += count;
+        }
+
+        for (u64 i = 0; i < len; ++i) {
+            const u64 pos = offsets[(radix_key(src_keys[i]) >> shift) & digit_mask]++;
+            dst_keys[pos] = src_keys[i];
+            if (has_values) dst_values[pos] = src_values[i];
+        }
+
+        swap(&src_keys, &dst_keys);
+        swap(&src_values, &dst_values);
+    }
+
+    if (src_keys != keys.ptr) {
+        copy(keys, Slice<K>{ src_keys, len });
+        if (has_values) copy(values, Slice<V>{ src_values, len });
+    }
+
+    return true;
+}
+
+// Scratch memory (len keys and the histograms) comes from allocator. Short slices fall back to
+// sort() with the same ordering
+[[nodiscard]] bool
+radix_sort(const Allocator allocator, const Slice<u32> keys);
+
+[[nodiscard]] bool
+radix_sort(const Allocator allocator, const Slice<u64> keys);
+
+[[nodiscard]] bool
+radix_sort(const Allocator allocator, const Slice<f32> keys);
+
+// Sorts keys and reorders values the same way, stable
+template <typename K, typename V>
+[[nodiscard]] bool
+radix_sort(const Allocator allocator, const Slice<K> keys, const Slice<V> values) {
+    return radix_sort_impl(allocator, keys, values);
+}
+
+} // namespace mem
+} // namespace mksv
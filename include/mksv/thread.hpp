@@ -0,0 +1,39 @@
+#pragma once
+
+#include "ctx.hpp"
+#include "types.hpp"
+
+namespace mksv {
+namespace thread {
+
+using ThreadFn = void (*)(void* ctx);
+using TaskFn = void (*)(void* ctx, const u32 task_index);
+
+// Upper bound of tasks for run_parallel()
+constexpr u32 MAX_TASKS = 64;
+
+struct Thread {
+    // OS handle (HANDLE or pthread_t), kept opaque to stay out of the system headers
+    u64 handle;
+    ThreadFn fn;
+    void* ctx;
+
+    // out_thread is handed to the new thread, it must stay at the same address until join()
+    [[nodiscard]] static bool
+    spawn(const ThreadFn fn, void* ctx, Thread* out_thread);
+
+    void
+    join();
+};
+
+// Number of logical processors available to the process, at least 1
+u32
+cpu_count();
+
+// Runs fn(ctx, i) for every i in [0, task_count) and waits for all of them. The calling thread
+// runs task 0, tasks that can't get a thread run on the calling thread too
+void
+run_parallel(const u32 task_count, const TaskFn fn, void* ctx);
+
+} // namespace thread
+} // namespace mksv
@@ -26,5 +26,13 @@ struct is_same<T, T> : public true_type {};
 template <typename T, typename U>
 inline constexpr bool is_same_v = is_same<T, U>::value;
 
+template <typename T>
+inline constexpr bool is_trivially_copyable_v = __is_trivially_copyable(T);
+
+// True when equal values always have equal bytes (no padding, no floats)
+template <typename T>
+inline constexpr bool has_unique_object_representations_v =
+    __has_unique_object_representations(T);
+
 } // namespace traits
 } // namespace mksv
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "mem.hpp"
+
+namespace mksv {
+namespace utf8 {
+
+constexpr u32 REPLACEMENT_CHARACTER = 0xFFFD;
+
+// Rejects overlong encodings, surrogates, codepoints above U+10FFFF and truncated sequences.
+// On x64 the lookup validator runs 16 bytes at a time when the CPU has SSSE3, or 32 bytes at a
+// time when built with -mavx2
+[[nodiscard]] bool
+validate(const Str text);
+
+// Decodes the sequence starting at text[index], fails on invalid or truncated sequences
+[[nodiscard]] bool
+decode(const Str text, const u64 index, u32* out_codepoint, u64* out_len);
+
+// Invalid bytes are reported one at a time as REPLACEMENT_CHARACTER
+struct CodepointIter {
+    Str text;
+    u64 index;
+    // Bytes before this offset are known to be ASCII
+    u64 ascii_end;
+
+    [[nodiscard]] bool
+    next(u32* out_codepoint);
+};
+
+CodepointIter
+codepoints(const Str text);
+
+} // namespace utf8
+} // namespace mksv
@@ -28,6 +28,16 @@ _defer_func(F func) {
     return _Defer<F>(func);
 }
 
+// Member that makes the enclosing struct non-copyable, for types that hand out pointers to
+// themselves. The struct stays an aggregate
+struct Pinned {
+    Pinned() = default;
+    Pinned(const Pinned&) = delete;
+
+    Pinned&
+    operator=(const Pinned&) = delete;
+};
+
 inline constexpr bool
 is_digit(const u8 c) {
     return (c >= '0' && c <= '9');
@@ -1,12 +1,15 @@
 #include "heap.hpp"
 
+#include "bit.hpp"
 #include "ctx.hpp"
+#include "fmt.hpp"
 #include "mem.hpp"
+#include "utils.hpp"
 
 #if OS_WINDOWS
 #include <windows.h>
 #endif
-#if OS_MACOS
+#if OS_MACOS | OS_LINUX
 #include <sys/mman.h>
 #include <unistd.h>
 #endif
@@ -27,11 +30,9 @@ init_ctx(OsCtx* ctx) {
 
     ctx->allocation_granularity = (u64)sys_info.dwAllocationGranularity;
     ctx->is_init = true;
-#elif OS_MACOS
+#elif OS_MACOS | OS_LINUX
     ctx->allocation_granularity = (u64)getpagesize();
     ctx->is_init = true;
-#elif OS_LINUX
-
 #endif
 }
 
@@ -66,13 +67,67 @@ os_allocate(void* ctx, const u64 size, const u64 alignment, mem::Slice<u8>* out_
 
 static bool
 os_resize(void* ctx, void* ptr, const u64 old_size, const u64 new_size, const u64 alignment) {
-    (void)ctx;
-    (void)ptr;
-    (void)old_size;
-    (void)new_size;
+    OsCtx* ctx_ptr = (OsCtx*)ctx;
+    if (!ctx_ptr->is_init) init_ctx(ctx_ptr);
     (void)alignment;
 
-    return false;
+    if (ptr == nullptr || old_size == 0 || new_size == 0) return false;
+
+    const u64 old_aligned = mem::align_up(old_size, ctx_ptr->allocation_granularity);
+    const u64 new_aligned = mem::align_up(new_size, ctx_ptr->allocation_granularity);
+
+#if OS_WINDOWS
+    // VirtualFree(MEM_RELEASE) releases the whole reservation, shrinking is free
+    return new_aligned <= old_aligned;
+#elif OS_MACOS
+    if (new_aligned > old_aligned) return false;
+    if (new_aligned < old_aligned) munmap((u8*)ptr + new_aligned, old_aligned - new_aligned);
+    return true;
+#elif OS_LINUX
+    if (new_aligned == old_aligned) return true;
+    if (new_aligned < old_aligned) {
+        munmap((u8*)ptr + new_aligned, old_aligned - new_aligned);
+        return true;
+    }
+
+    // Grow in place only, fails if the following pages are already mapped
+    return mremap(ptr, old_aligned, new_aligned, 0) != MAP_FAILED;
+#else
+#error "Unsupported OS"
+#endif
+}
+
+static bool
+os_remap(
+    void* ctx,
+    void* ptr,
+    const u64 old_size,
+    const u64 new_size,
+    const u64 alignment,
+    void** out_ptr
+) {
+#if OS_LINUX
+    OsCtx* ctx_ptr = (OsCtx*)ctx;
+    if (!ctx_ptr->is_init) init_ctx(ctx_ptr);
+
+    if (ptr == nullptr || old_size == 0 || new_size == 0) return false;
+    // mremap only guarantees page alignment when it moves the mapping
+    if (alignment > ctx_ptr->allocation_granularity) return false;
+
+    const u64 old_aligned = mem::align_up(old_size, ctx_ptr->allocation_granularity);
+    const u64 new_aligned = mem::align_up(new_size, ctx_ptr->allocation_granularity);
+
+    // Page table entries are moved, the data itself is never copied
+    void* block = mremap(ptr, old_aligned, new_aligned, MREMAP_MAYMOVE);
+    if (block == MAP_FAILED) return false;
+
+    *out_ptr = block;
+    return true;
+#else
+    if (!os_resize(ctx, ptr, old_size, new_size, alignment)) return false;
+    *out_ptr = ptr;
+    return true;
+#endif
 }
 
 static void
@@ -83,7 +138,208 @@ os_free(void* ctx, void* ptr, const u64 size, const u64 alignment) {
 #if OS_WINDOWS
     (void)size;
     VirtualFree(ptr, 0, MEM_RELEASE);
+#elif OS_MACOS | OS_LINUX
+    munmap(ptr, size);
+#else
+#error "Unsupported OS"
+#endif
+}
+
+static bool
+huge_allocate(void* ctx, const u64 size, const u64 alignment, mem::Slice<u8>* out_block) {
+    if (size < HUGE_PAGE_SIZE || alignment > HUGE_PAGE_SIZE) {
+        return os_allocate(ctx, size, alignment, out_block);
+    }
+
+    const u64 aligned_size = mem::align_up(size, HUGE_PAGE_SIZE);
+
+#if OS_WINDOWS
+    // Requires SeLockMemoryPrivilege and a multiple of the large page size, fall back to regular
+    // pages without it
+    const u64 large_page_size = (u64)GetLargePageMinimum();
+    if (large_page_size != 0) {
+        const u64 large_size = mem::align_up(size, large_page_size);
+        void* block = VirtualAlloc(
+            nullptr, large_size, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE
+        );
+        if (block != nullptr) {
+            *out_block = mem::Slice<u8>{ (u8*)block, large_size };
+            return true;
+        }
+    }
+
+    void* block = VirtualAlloc(nullptr, aligned_size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (block == nullptr) return false;
+
+    *out_block = mem::Slice<u8>{ (u8*)block, aligned_size };
+    return true;
+#elif OS_LINUX
+    void* block = mmap(
+        nullptr,
+        aligned_size,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANON | MAP_HUGETLB,
+        -1,
+        0
+    );
+    if (block != MAP_FAILED) {
+        *out_block = mem::Slice<u8>{ (u8*)block, aligned_size };
+        return true;
+    }
+
+    // No reserved huge pages, map extra space to align the block on a huge page boundary and
+    // let transparent huge pages back it
+    const u64 mapped_size = aligned_size + HUGE_PAGE_SIZE;
+    block = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (block == MAP_FAILED) return false;
+
+    u8* start = (u8*)mem::align_up((u64)block, HUGE_PAGE_SIZE);
+    const u64 head = (u64)(start - (u8*)block);
+    if (head > 0) munmap(block, head);
+    if (mapped_size - head > aligned_size) {
+        munmap(start + aligned_size, mapped_size - head - aligned_size);
+    }
+
+    madvise(start, aligned_size, MADV_HUGEPAGE);
+
+    *out_block = mem::Slice<u8>{ start, aligned_size };
+    return true;
 #elif OS_MACOS
+    return os_allocate(ctx, size, alignment, out_block);
+#else
+#error "Unsupported OS"
+#endif
+}
+
+static bool
+huge_resize(void* ctx, void* ptr, const u64 old_size, const u64 new_size, const u64 alignment) {
+    const bool old_huge = old_size >= HUGE_PAGE_SIZE && alignment <= HUGE_PAGE_SIZE;
+    const bool new_huge = new_size >= HUGE_PAGE_SIZE && alignment <= HUGE_PAGE_SIZE;
+    if (!old_huge && !new_huge) return os_resize(ctx, ptr, old_size, new_size, alignment);
+    if (old_huge != new_huge) return false;
+
+    // Huge blocks keep their mapping, only a resize within the same huge page count is possible
+    return mem::align_up(old_size, HUGE_PAGE_SIZE) == mem::align_up(new_size, HUGE_PAGE_SIZE);
+}
+
+static bool
+huge_remap(
+    void* ctx,
+    void* ptr,
+    const u64 old_size,
+    const u64 new_size,
+    const u64 alignment,
+    void** out_ptr
+) {
+    if (old_size < HUGE_PAGE_SIZE && new_size < HUGE_PAGE_SIZE) {
+        return os_remap(ctx, ptr, old_size, new_size, alignment, out_ptr);
+    }
+
+#if OS_LINUX
+    const bool old_huge = old_size >= HUGE_PAGE_SIZE && alignment <= HUGE_PAGE_SIZE;
+    const bool new_huge = new_size >= HUGE_PAGE_SIZE && alignment <= HUGE_PAGE_SIZE;
+    if (ptr != nullptr && old_huge && new_huge) {
+        const u64 old_aligned = mem::align_up(old_size, HUGE_PAGE_SIZE);
+        const u64 new_aligned = mem::align_up(new_size, HUGE_PAGE_SIZE);
+
+        void* block = mremap(ptr, old_aligned, new_aligned, 0);
+        if (block == MAP_FAILED) {
+            // Move the page tables into a huge page aligned reservation, so the block keeps its
+            // alignment and huge page mappings move without being split
+            const u64 reserve_size = new_aligned + HUGE_PAGE_SIZE;
+            void* reserved = mmap(
+                nullptr, reserve_size, PROT_NONE, MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0
+            );
+            if (reserved == MAP_FAILED) return false;
+
+            u8* target = (u8*)mem::align_up((u64)reserved, HUGE_PAGE_SIZE);
+            block = mremap(ptr, old_aligned, new_aligned, MREMAP_MAYMOVE | MREMAP_FIXED, target);
+            if (block == MAP_FAILED) {
+                munmap(reserved, reserve_size);
+                return false;
+            }
+
+            const u64 head = (u64)(target - (u8*)reserved);
+            if (head > 0) munmap(reserved, head);
+            if (reserve_size - head > new_aligned) {
+                munmap(target + new_aligned, reserve_size - head - new_aligned);
+            }
+        }
+
+        *out_ptr = block;
+        return true;
+    }
+#endif
+
+    if (!huge_resize(ctx, ptr, old_size, new_size, alignment)) return false;
+    *out_ptr = ptr;
+
+    return true;
+}
+
+static void
+huge_free(void* ctx, void* ptr, const u64 size, const u64 alignment) {
+    if (size < HUGE_PAGE_SIZE || alignment > HUGE_PAGE_SIZE) {
+        os_free(ctx, ptr, size, alignment);
+        return;
+    }
+
+    os_free(ctx, ptr, mem::align_up(size, HUGE_PAGE_SIZE), alignment);
+}
+
+mem::Allocator
+huge_page_allocator() {
+    return {
+        .ctx = &os_ctx,
+        .vtable = {
+            .alloc_fn = &huge_allocate,
+            .resize_fn = &huge_resize,
+            .free_fn = &huge_free,
+            .remap_fn = &huge_remap,
+        },
+    };
+}
+
+// Reserves address space without backing memory
+static bool
+os_reserve(const u64 size, mem::Slice<u8>* out_block) {
+    if (!os_ctx.is_init) init_ctx(&os_ctx);
+
+    const u64 aligned_size = mem::align_up(size, os_ctx.allocation_granularity);
+
+#if OS_WINDOWS
+    void* block = VirtualAlloc(nullptr, aligned_size, MEM_RESERVE, PAGE_NOACCESS);
+    if (block == nullptr) return false;
+#elif OS_MACOS | OS_LINUX
+    void* block =
+        mmap(nullptr, aligned_size, PROT_NONE, MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+    if (block == MAP_FAILED) return false;
+#else
+#error "Unsupported OS"
+#endif
+
+    *out_block = mem::Slice<u8>{ (u8*)block, aligned_size };
+    return true;
+}
+
+// Makes reserved pages readable and writable
+static bool
+os_commit(void* ptr, const u64 size) {
+#if OS_WINDOWS
+    return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#elif OS_MACOS | OS_LINUX
+    return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+#else
+#error "Unsupported OS"
+#endif
+}
+
+static void
+os_release(void* ptr, const u64 size) {
+#if OS_WINDOWS
+    (void)size;
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#elif OS_MACOS | OS_LINUX
     munmap(ptr, size);
 #else
 #error "Unsupported OS"
@@ -98,10 +354,52 @@ system_allocator() {
             .alloc_fn = &os_allocate,
             .resize_fn = &os_resize,
             .free_fn = &os_free,
+            .remap_fn = &os_remap,
         },
     };
 }
 
+// Returns true if ptr is the most recent allocation of the head node
+static bool
+arena_is_top(const ArenaAllocator* arena, const void* ptr, const u64 size, const u64 alignment) {
+    if (arena->stack.head == nullptr) return false;
+
+    const u8* base = arena->stack.head->data.ptr;
+    const u64 aligned_size = mem::align_up(size, alignment);
+    if (aligned_size > arena->end_idx) return false;
+
+    return (const u8*)ptr == base + arena->end_idx - aligned_size;
+}
+
+// Moves the head node to the free list, or gives it back if over the retain limit
+static void
+arena_release_head(ArenaAllocator* arena) {
+    ArenaAllocator::Node* node = arena->stack.head;
+    arena->stack.remove_node(node);
+
+    if (arena->retained_bytes + node->data.len > arena->retain_limit) {
+        arena->inner_allocator.free(node->data);
+        return;
+    }
+
+    arena->free_nodes.prepend_node(node);
+    arena->retained_bytes += node->data.len;
+}
+
+// Pops a retained node of at least len bytes aligned to alignment
+static ArenaAllocator::Node*
+arena_take_free_node(ArenaAllocator* arena, const u64 len, const u64 alignment) {
+    for (auto node = arena->free_nodes.head; node; node = node->next) {
+        if (node->data.len < len || (u64)node->data.ptr % alignment != 0) continue;
+
+        arena->free_nodes.remove_node(node);
+        arena->retained_bytes -= node->data.len;
+        return node;
+    }
+
+    return nullptr;
+}
+
 static bool
 arena_alloc(void* ctx, const u64 size, const u64 alignment, mem::Slice<u8>* out_block) {
     ArenaAllocator* context = (ArenaAllocator*)ctx;
@@ -110,9 +408,9 @@ arena_alloc(void* ctx, const u64 size, const u64 alignment, mem::Slice<u8>* out_
 
     if (context->stack.head) {
         const auto head = context->stack.head;
-        const u64 aligned_index = mem::align_up(context->end_idx, alignment);
-        const u64 size_left = head->data.len - aligned_index;
-        if (size_left >= aligned_size) {
+        const u64 base = (u64)head->data.ptr;
+        const u64 aligned_index = mem::align_up(base + context->end_idx, alignment) - base;
+        if (aligned_index <= head->data.len && head->data.len - aligned_index >= aligned_size) {
             *out_block = mem::Slice<u8>{ head->data.ptr + aligned_index, size };
             context->end_idx = aligned_index;
             context->end_idx += aligned_size;
@@ -120,18 +418,29 @@ arena_alloc(void* ctx, const u64 size, const u64 alignment, mem::Slice<u8>* out_
         }
     }
 
-    const u64 aligned_node_size = mem::align_up(ArenaAllocator::NODE_SIZE, alignment);
+    const u64 node_alignment = math::max(alignment, (u64)alignof(ArenaAllocator::Node));
+    const u64 aligned_node_size = mem::align_up(ArenaAllocator::NODE_SIZE, node_alignment);
 
-    mem::Slice<u8> block = {};
-    if (!context->inner_allocator.raw_alloc(aligned_size + aligned_node_size, alignment, &block))
-        return false;
+    // Grow geometrically so a sequence of allocations needs O(log n) nodes
+    const u64 prev_len = context->stack.head ? context->stack.head->data.len : 0;
+    const u64 min_len = aligned_node_size + aligned_size;
+    const u64 node_len = min_len + prev_len + (min_len + prev_len) / 2;
+
+    ArenaAllocator::Node* node = arena_take_free_node(context, min_len, node_alignment);
+    if (node == nullptr) {
+        mem::Slice<u8> block = {};
+        if (!context->inner_allocator.raw_alloc(node_len, node_alignment, &block)) {
+            if (!context->inner_allocator.raw_alloc(min_len, node_alignment, &block)) return false;
+        }
+
+        node = (ArenaAllocator::Node*)block.ptr;
+        node->data = block;
+    }
 
-    ArenaAllocator::Node* node = (ArenaAllocator::Node*)block.ptr;
-    node->data = block;
     context->stack.prepend_node(node);
     context->end_idx = aligned_node_size + aligned_size;
 
-    *out_block = mem::Slice<u8>{ block.ptr + aligned_node_size, size };
+    *out_block = mem::Slice<u8>{ node->data.ptr + aligned_node_size, size };
 
     return true;
 }
@@ -139,27 +448,46 @@ arena_alloc(void* ctx, const u64 size, const u64 alignment, mem::Slice<u8>* out_
 static bool
 arena_resize(void* ctx, void* ptr, const u64 old_size, const u64 new_size, const u64 alignment) {
     ArenaAllocator* context = (ArenaAllocator*)ctx;
-    (void)context;
-    (void)ptr;
-    (void)old_size;
-    (void)new_size;
-    (void)alignment;
-    return false;
+
+    if (!arena_is_top(context, ptr, old_size, alignment)) {
+        // Shrinking in place is always possible, the memory is just not reclaimed
+        return new_size <= old_size;
+    }
+
+    const auto head = context->stack.head;
+    const u64 start_idx = (u64)((u8*)ptr - head->data.ptr);
+    const u64 aligned_size = mem::align_up(new_size, alignment);
+    if (aligned_size > head->data.len - start_idx) return false;
+
+    context->end_idx = start_idx + aligned_size;
+
+    return true;
 }
 
 static void
 arena_free(void* ctx, void* ptr, const u64 size, const u64 alignment) {
-    (void)ctx;
-    (void)ptr;
-    (void)size;
-    (void)alignment;
+    ArenaAllocator* context = (ArenaAllocator*)ctx;
+
+    // Only the most recent allocation can be given back
+    if (arena_is_top(context, ptr, size, alignment)) {
+        context->end_idx -= mem::align_up(size, alignment);
+    }
 }
 
 ArenaAllocator
 ArenaAllocator::init(const mem::Allocator inner) {
+    return init(inner, math::MAX_U64);
+}
+
+ArenaAllocator
+ArenaAllocator::init(const mem::Allocator inner, const u64 retain_limit) {
     return {
         .inner_allocator = inner,
+        .stack = {},
         .end_idx = 0,
+        .free_nodes = {},
+        .retained_bytes = 0,
+        .retain_limit = retain_limit,
     };
 }
 
@@ -171,20 +499,1649 @@ ArenaAllocator::allocator() const {
             .alloc_fn = &arena_alloc,
             .resize_fn = &arena_resize,
             .free_fn = &arena_free,
+            .remap_fn = nullptr,
         },
     };
 }
 
+ArenaAllocator::Marker
+ArenaAllocator::save() const {
+    return {
+        .node = stack.head,
+        .end_idx = end_idx,
+    };
+}
+
+void
+ArenaAllocator::restore(const Marker marker) {
+    while (stack.head && stack.head != marker.node) arena_release_head(this);
+    assert(stack.head == marker.node);
+
+    end_idx = marker.end_idx;
+}
+
+void
+ArenaAllocator::reset() {
+    restore({ .node = nullptr, .end_idx = 0 });
+}
+
 void
 ArenaAllocator::deinit() {
-    auto ptr = stack.head;
+    Stack* lists[] = { &stack, &free_nodes };
+    for (Stack* list : lists) {
+        auto ptr = list->head;
+        while (ptr) {
+            const auto tmp = ptr->next;
+            ArenaAllocator::Node node;
+            assert(list->pop_front(&node));
+            inner_allocator.free(node.data);
+            ptr = tmp;
+        }
+    }
+    end_idx = 0;
+    retained_bytes = 0;
+}
+
+static bool
+pool_alloc(void* ctx, const u64 size, const u64 alignment, mem::Slice<u8>* out_block) {
+    PoolAllocator* pool = (PoolAllocator*)ctx;
+
+    if (size > pool->block_size || alignment > pool->block_alignment) return false;
+
+    if (pool->free_list) {
+        PoolAllocator::FreeBlock* block = pool->free_list;
+        pool->free_list = block->next;
+        *out_block = mem::Slice<u8>{ (u8*)block, size };
+        return true;
+    }
+
+    if ((u64)(pool->bump_end - pool->bump_ptr) < pool->block_size) {
+        const u64 chunk_alignment =
+            math::max(pool->block_alignment, (u64)alignof(PoolAllocator::Chunk));
+        const u64 header_size = mem::align_up(sizeof(PoolAllocator::Chunk), chunk_alignment);
+        const u64 chunk_size = math::max(PoolAllocator::CHUNK_SIZE, header_size + pool->block_size);
+
+        mem::Slice<u8> chunk_block = {};
+        if (!pool->inner_allocator.raw_alloc(chunk_size, chunk_alignment, &chunk_block))
+            return false;
+
+        PoolAllocator::Chunk* chunk = (PoolAllocator::Chunk*)chunk_block.ptr;
+        chunk->data = chunk_block;
+        pool->chunks.prepend_node(chunk);
+
+        pool->bump_ptr = chunk_block.ptr + header_size;
+        pool->bump_end = chunk_block.ptr + chunk_block.len;
+    }
+
+    *out_block = mem::Slice<u8>{ pool->bump_ptr, size };
+    pool->bump_ptr += pool->block_size;
+
+    return true;
+}
+
+static bool
+pool_resize(void* ctx, void* ptr, const u64 old_size, const u64 new_size, const u64 alignment) {
+    PoolAllocator* pool = (PoolAllocator*)ctx;
+    (void)old_size;
+    (void)alignment;
+
+    if (ptr == nullptr) return false;
+
+    return new_size <= pool->block_size;
+}
+
+static void
+pool_free(void* ctx, void* ptr, const u64 size, const u64 alignment) {
+    PoolAllocator* pool = (PoolAllocator*)ctx;
+    (void)size;
+    (void)alignment;
+
+    if (ptr == nullptr) return;
+
+    PoolAllocator::FreeBlock* block = (PoolAllocator::FreeBlock*)ptr;
+    block->next = pool->free_list;
+    pool->free_list = block;
+}
+
+PoolAllocator
+PoolAllocator::init(const mem::Allocator inner, const u64 size, const u64 alignment) {
+    // Every block must be able to hold a free list link
+    const u64 block_alignment = math::max(alignment, (u64)alignof(FreeBlock));
+    const u64 block_size = mem::align_up(math::max(size, (u64)sizeof(FreeBlock)), block_alignment);
+
+    return {
+        .inner_allocator = inner,
+        .chunks = {},
+        .free_list = nullptr,
+        .bump_ptr = nullptr,
+        .bump_end = nullptr,
+        .block_size = block_size,
+        .block_alignment = block_alignment,
+    };
+}
+
+mem::Allocator
+PoolAllocator::allocator() const {
+    return {
+        .ctx = (void*)this,
+        .vtable = {
+            .alloc_fn = &pool_alloc,
+            .resize_fn = &pool_resize,
+            .free_fn = &pool_free,
+            .remap_fn = nullptr,
+        },
+    };
+}
+
+void
+PoolAllocator::deinit() {
+    auto ptr = chunks.head;
     while (ptr) {
         const auto tmp = ptr->next;
-        ArenaAllocator::Node node;
-        assert(stack.pop_front(&node));
-        inner_allocator.free(node.data);
+        Chunk chunk;
+        assert(chunks.pop_front(&chunk));
+        inner_allocator.free(chunk.data);
         ptr = tmp;
     }
+    free_list = nullptr;
+    bump_ptr = nullptr;
+    bump_end = nullptr;
+}
+
+static bool
+gpa_is_small(const u64 size, const u64 alignment) {
+    return size <= GeneralPurposeAllocator::MAX_CLASS_SIZE &&
+           alignment <= GeneralPurposeAllocator::MAX_CLASS_ALIGNMENT;
+}
+
+// Index of the smallest class holding size bytes aligned to alignment
+static u64
+gpa_class_index(const u64 size, const u64 alignment) {
+    const u64 len = math::max(size, alignment);
+
+    // Bounded by CLASS_COUNT iterations
+    u64 idx = 0;
+    while ((GeneralPurposeAllocator::MIN_CLASS_SIZE << idx) < len) ++idx;
+
+    return idx;
+}
+
+static bool
+gpa_alloc(void* ctx, const u64 size, const u64 alignment, mem::Slice<u8>* out_block) {
+    GeneralPurposeAllocator* gpa = (GeneralPurposeAllocator*)ctx;
+
+    if (!gpa_is_small(size, alignment)) {
+        return gpa->inner_allocator.raw_alloc(size, alignment, out_block);
+    }
+
+    const u64 idx = gpa_class_index(size, alignment);
+    return pool_alloc(&gpa->pools[idx], size, alignment, out_block);
+}
+
+static bool
+gpa_resize(void* ctx, void* ptr, const u64 old_size, const u64 new_size, const u64 alignment) {
+    GeneralPurposeAllocator* gpa = (GeneralPurposeAllocator*)ctx;
+
+    if (ptr == nullptr) return false;
+
+    const bool old_small = gpa_is_small(old_size, alignment);
+    const bool new_small = gpa_is_small(new_size, alignment);
+    if (!old_small && !new_small) {
+        const mem::Allocator inner = gpa->inner_allocator;
+        return inner.vtable.resize_fn(inner.ctx, ptr, old_size, new_size, alignment);
+    }
+
+    // The block must stay in its class so free() finds the same pool
+    if (old_small != new_small) return false;
+    return gpa_class_index(old_size, alignment) == gpa_class_index(new_size, alignment);
+}
+
+static bool
+gpa_remap(
+    void* ctx,
+    void* ptr,
+    const u64 old_size,
+    const u64 new_size,
+    const u64 alignment,
+    void** out_ptr
+) {
+    GeneralPurposeAllocator* gpa = (GeneralPurposeAllocator*)ctx;
+    const mem::Allocator inner = gpa->inner_allocator;
+
+    if (!gpa_is_small(old_size, alignment) && !gpa_is_small(new_size, alignment) &&
+        inner.vtable.remap_fn) {
+        return inner.vtable.remap_fn(inner.ctx, ptr, old_size, new_size, alignment, out_ptr);
+    }
+
+    if (!gpa_resize(ctx, ptr, old_size, new_size, alignment)) return false;
+    *out_ptr = ptr;
+
+    return true;
+}
+
+static void
+gpa_free(void* ctx, void* ptr, const u64 size, const u64 alignment) {
+    GeneralPurposeAllocator* gpa = (GeneralPurposeAllocator*)ctx;
+
+    if (!gpa_is_small(size, alignment)) {
+        const mem::Allocator inner = gpa->inner_allocator;
+        inner.vtable.free_fn(inner.ctx, ptr, size, alignment);
+        return;
+    }
+
+    const u64 idx = gpa_class_index(size, alignment);
+    pool_free(&gpa->pools[idx], ptr, size, alignment);
+}
+
+GeneralPurposeAllocator
+GeneralPurposeAllocator::init(const mem::Allocator inner) {
+    GeneralPurposeAllocator gpa = {
+        .inner_allocator = inner,
+        .pools = {},
+    };
+
+    for (u64 idx = 0; idx < CLASS_COUNT; ++idx) {
+        const u64 class_size = MIN_CLASS_SIZE << idx;
+        gpa.pools[idx] =
+            PoolAllocator::init(inner, class_size, math::min(class_size, MAX_CLASS_ALIGNMENT));
+    }
+
+    return gpa;
+}
+
+mem::Allocator
+GeneralPurposeAllocator::allocator() const {
+    return {
+        .ctx = (void*)this,
+        .vtable = {
+            .alloc_fn = &gpa_alloc,
+            .resize_fn = &gpa_resize,
+            .free_fn = &gpa_free,
+            .remap_fn = &gpa_remap,
+        },
+    };
+}
+
+void
+GeneralPurposeAllocator::deinit() {
+    for (auto& pool : pools) pool.deinit();
+}
+
+static u64 caching_next_id = 1;
+
+struct CachingSlot {
+    u64 id;
+    ThreadCachingAllocator* owner;
+    ThreadCachingAllocator::ThreadCache* cache;
+};
+
+// Thread caches are owned by the slots of the thread using them. Every thread with a slot in use
+// is linked here so deinit() can clear its slots, nothing here points into an allocator.
+// Taken before any allocator lock
+static atomic::SpinLock caching_threads_lock;
+static struct CachingSlots* caching_threads = nullptr;
+
+static u64
+caching_class_size(const u64 idx) {
+    return GeneralPurposeAllocator::MIN_CLASS_SIZE << idx;
+}
+
+static u64
+caching_class_alignment(const u64 idx) {
+    return math::min(caching_class_size(idx), GeneralPurposeAllocator::MAX_CLASS_ALIGNMENT);
+}
+
+// Caller must hold the lock
+static void
+caching_drain(
+    ThreadCachingAllocator* tca,
+    ThreadCachingAllocator::ClassCache* cache,
+    const u64 idx,
+    u64 n
+) {
+    const mem::Allocator backend = tca->backend;
+    while (n > 0 && cache->head) {
+        ThreadCachingAllocator::FreeBlock* block = cache->head;
+        cache->head = block->next;
+        --cache->count;
+        --n;
+        backend.vtable.free_fn(
+            backend.ctx, block, caching_class_size(idx), caching_class_alignment(idx)
+        );
+    }
+}
+
+// Drains the slot's cache back to its allocator and frees it. Does nothing if the allocator's
+// deinit already cleared the slot
+static void
+caching_release(CachingSlot* slot) {
+    caching_threads_lock.lock();
+
+    ThreadCachingAllocator* tca = slot->owner;
+    ThreadCachingAllocator::ThreadCache* cache = slot->cache;
+    *slot = {};
+    if (cache == nullptr) {
+        caching_threads_lock.unlock();
+        return;
+    }
+
+    // Holding tca->lock keeps deinit from running past this point, the slot lock isn't needed
+    // while draining
+    tca->lock.lock();
+    caching_threads_lock.unlock();
+    defer(tca->lock.unlock());
+
+    ThreadCachingAllocator::ThreadCache** link = &tca->caches;
+    while (*link && *link != cache) link = &(*link)->next;
+    if (*link) *link = cache->next;
+
+    for (u64 idx = 0; idx < ThreadCachingAllocator::CLASS_COUNT; ++idx) {
+        caching_drain(tca, &cache->classes[idx], idx, cache->classes[idx].count);
+    }
+
+    const mem::Allocator backend = tca->backend;
+    backend.vtable.free_fn(
+        backend.ctx,
+        cache,
+        sizeof(ThreadCachingAllocator::ThreadCache),
+        alignof(ThreadCachingAllocator::ThreadCache)
+    );
+}
+
+static thread_local struct CachingSlots {
+    CachingSlot slots[ThreadCachingAllocator::THREAD_SLOTS];
+    u64 next_slot;
+    CachingSlots* next;
+    bool linked;
+    // Set once the destructor ran, later calls on this thread bypass the caches
+    bool exited;
+
+    // Flushes the exiting thread's caches
+    ~CachingSlots() {
+        for (auto& slot : slots) caching_release(&slot);
+        exited = true;
+
+        if (!linked) return;
+
+        caching_threads_lock.lock();
+        defer(caching_threads_lock.unlock());
+
+        CachingSlots** link = &caching_threads;
+        while (*link && *link != this) link = &(*link)->next;
+        if (*link) *link = next;
+        linked = false;
+    }
+} caching_slots;
+
+// Returns the calling thread's cache, creating it on first use. nullptr if it can't be created
+static ThreadCachingAllocator::ThreadCache*
+caching_thread_cache(ThreadCachingAllocator* tca) {
+    for (const auto& slot : caching_slots.slots) {
+        if (slot.id == tca->id) return slot.cache;
+    }
+
+    if (caching_slots.exited) return nullptr;
+
+    // Evict before taking tca->lock, releasing takes the thread list lock first
+    CachingSlot* slot = &caching_slots.slots[caching_slots.next_slot];
+    caching_slots.next_slot = (caching_slots.next_slot + 1) % ThreadCachingAllocator::THREAD_SLOTS;
+    caching_release(slot);
+
+    ThreadCachingAllocator::ThreadCache* cache = nullptr;
+    {
+        tca->lock.lock();
+        defer(tca->lock.unlock());
+
+        mem::Slice<u8> block = {};
+        if (!tca->backend.raw_alloc(
+                sizeof(ThreadCachingAllocator::ThreadCache),
+                alignof(ThreadCachingAllocator::ThreadCache),
+                &block
+            ))
+            return nullptr;
+
+        cache = (ThreadCachingAllocator::ThreadCache*)block.ptr;
+        mem::zero(mem::Slice<ThreadCachingAllocator::ThreadCache>{ cache, 1 });
+        cache->next = tca->caches;
+        tca->caches = cache;
+    }
+
+    caching_threads_lock.lock();
+    defer(caching_threads_lock.unlock());
+
+    if (!caching_slots.linked) {
+        caching_slots.next = caching_threads;
+        caching_threads = &caching_slots;
+        caching_slots.linked = true;
+    }
+
+    *slot = {
+        .id = tca->id,
+        .owner = tca,
+        .cache = cache,
+    };
+
+    return cache;
+}
+
+static bool
+caching_alloc(void* ctx, const u64 size, const u64 alignment, mem::Slice<u8>* out_block) {
+    ThreadCachingAllocator* tca = (ThreadCachingAllocator*)ctx;
+
+    ThreadCachingAllocator::ThreadCache* thread_cache = nullptr;
+    if (gpa_is_small(size, alignment)) thread_cache = caching_thread_cache(tca);
+
+    if (thread_cache == nullptr) {
+        tca->lock.lock();
+        defer(tca->lock.unlock());
+        if (!gpa_is_small(size, alignment)) {
+            return tca->backend.raw_alloc(size, alignment, out_block);
+        }
+
+        // Same size as the free path, which always rounds small blocks to their class
+        const u64 idx = gpa_class_index(size, alignment);
+        if (!tca->backend.raw_alloc(
+                caching_class_size(idx), caching_class_alignment(idx), out_block
+            ))
+            return false;
+        out_block->len = size;
+        return true;
+    }
+
+    const u64 idx = gpa_class_index(size, alignment);
+    ThreadCachingAllocator::ClassCache* cache = &thread_cache->classes[idx];
+
+    if (cache->head == nullptr) {
+        tca->lock.lock();
+        defer(tca->lock.unlock());
+
+        for (u64 i = 0; i < ThreadCachingAllocator::BATCH_SIZE; ++i) {
+            mem::Slice<u8> block = {};
+            if (!tca->backend.raw_alloc(
+                    caching_class_size(idx), caching_class_alignment(idx), &block
+                ))
+                break;
+
+            ThreadCachingAllocator::FreeBlock* free_block =
+                (ThreadCachingAllocator::FreeBlock*)block.ptr;
+            free_block->next = cache->head;
+            cache->head = free_block;
+            ++cache->count;
+        }
+
+        if (cache->head == nullptr) return false;
+    }
+
+    ThreadCachingAllocator::FreeBlock* block = cache->head;
+    cache->head = block->next;
+    --cache->count;
+
+    *out_block = mem::Slice<u8>{ (u8*)block, size };
+
+    return true;
+}
+
+static bool
+caching_resize(void* ctx, void* ptr, const u64 old_size, const u64 new_size, const u64 alignment) {
+    ThreadCachingAllocator* tca = (ThreadCachingAllocator*)ctx;
+
+    if (ptr == nullptr) return false;
+
+    const bool old_small = gpa_is_small(old_size, alignment);
+    const bool new_small = gpa_is_small(new_size, alignment);
+    if (!old_small && !new_small) {
+        tca->lock.lock();
+        defer(tca->lock.unlock());
+        const mem::Allocator backend = tca->backend;
+        return backend.vtable.resize_fn(backend.ctx, ptr, old_size, new_size, alignment);
+    }
+
+    if (old_small != new_small) return false;
+    return gpa_class_index(old_size, alignment) == gpa_class_index(new_size, alignment);
+}
+
+static bool
+caching_remap(
+    void* ctx,
+    void* ptr,
+    const u64 old_size,
+    const u64 new_size,
+    const u64 alignment,
+    void** out_ptr
+) {
+    ThreadCachingAllocator* tca = (ThreadCachingAllocator*)ctx;
+    const mem::Allocator backend = tca->backend;
+
+    if (ptr != nullptr && !gpa_is_small(old_size, alignment) &&
+        !gpa_is_small(new_size, alignment) && backend.vtable.remap_fn) {
+        tca->lock.lock();
+        defer(tca->lock.unlock());
+        return backend.vtable.remap_fn(backend.ctx, ptr, old_size, new_size, alignment, out_ptr);
+    }
+
+    if (!caching_resize(ctx, ptr, old_size, new_size, alignment)) return false;
+    *out_ptr = ptr;
+
+    return true;
+}
+
+static void
+caching_free(void* ctx, void* ptr, const u64 size, const u64 alignment) {
+    ThreadCachingAllocator* tca = (ThreadCachingAllocator*)ctx;
+
+    if (ptr == nullptr) return;
+
+    ThreadCachingAllocator::ThreadCache* thread_cache = nullptr;
+    if (gpa_is_small(size, alignment)) thread_cache = caching_thread_cache(tca);
+
+    if (thread_cache == nullptr) {
+        tca->lock.lock();
+        defer(tca->lock.unlock());
+        const mem::Allocator backend = tca->backend;
+        if (gpa_is_small(size, alignment)) {
+            const u64 idx = gpa_class_index(size, alignment);
+            backend.vtable.free_fn(
+                backend.ctx, ptr, caching_class_size(idx), caching_class_alignment(idx)
+            );
+        } else {
+            backend.vtable.free_fn(backend.ctx, ptr, size, alignment);
+        }
+        return;
+    }
+
+    const u64 idx = gpa_class_index(size, alignment);
+    ThreadCachingAllocator::ClassCache* cache = &thread_cache->classes[idx];
+
+    ThreadCachingAllocator::FreeBlock* block = (ThreadCachingAllocator::FreeBlock*)ptr;
+    block->next = cache->head;
+    cache->head = block;
+    ++cache->count;
+
+    if (cache->count > ThreadCachingAllocator::CACHE_CAPACITY) {
+        tca->lock.lock();
+        defer(tca->lock.unlock());
+        caching_drain(tca, cache, idx, ThreadCachingAllocator::BATCH_SIZE);
+    }
+}
+
+ThreadCachingAllocator
+ThreadCachingAllocator::init(const mem::Allocator backend) {
+    return {
+        .backend = backend,
+        .lock = {},
+        .caches = nullptr,
+        .id = atomic::fetch_add(&caching_next_id, (u64)1),
+    };
+}
+
+mem::Allocator
+ThreadCachingAllocator::allocator() const {
+    return {
+        .ctx = (void*)this,
+        .vtable = {
+            .alloc_fn = &caching_alloc,
+            .resize_fn = &caching_resize,
+            .free_fn = &caching_free,
+            .remap_fn = &caching_remap,
+        },
+    };
+}
+
+void
+ThreadCachingAllocator::deinit() {
+    // Threads that used this allocator forget their cache, it is released below
+    {
+        caching_threads_lock.lock();
+        defer(caching_threads_lock.unlock());
+
+        for (CachingSlots* thread = caching_threads; thread; thread = thread->next) {
+            for (auto& slot : thread->slots) {
+                if (slot.id == id) slot = {};
+            }
+        }
+    }
+
+    // Waits for a thread exit that claimed its slot before the loop above
+    lock.lock();
+    defer(lock.unlock());
+
+    ThreadCache* cache = caches;
+    while (cache) {
+        ThreadCache* next = cache->next;
+        for (u64 idx = 0; idx < CLASS_COUNT; ++idx) {
+            caching_drain(this, &cache->classes[idx], idx, cache->classes[idx].count);
+        }
+        backend.vtable.free_fn(backend.ctx, cache, sizeof(ThreadCache), alignof(ThreadCache));
+        cache = next;
+    }
+    caches = nullptr;
+}
+
+// Commits pages so that the first end bytes of the reservation are usable
+static bool
+virtual_arena_commit(VirtualArena* arena, const u64 end) {
+    if (end <= arena->committed) return true;
+    if (end > arena->reserved.len) return false;
+
+    const u64 granularity = math::max(VirtualArena::COMMIT_SIZE, os_ctx.allocation_granularity);
+    const u64 new_committed = math::min(mem::align_up(end, granularity), arena->reserved.len);
+    if (!os_commit(arena->reserved.ptr + arena->committed, new_committed - arena->committed))
+        return false;
+
+    arena->committed = new_committed;
+
+    return true;
+}
+
+static bool
+virtual_arena_is_top(
+    const VirtualArena* arena,
+    const void* ptr,
+    const u64 size,
+    const u64 alignment
+) {
+    const u64 aligned_size = mem::align_up(size, alignment);
+    if (aligned_size > arena->end_idx) return false;
+
+    return (const u8*)ptr == arena->reserved.ptr + arena->end_idx - aligned_size;
+}
+
+static bool
+virtual_arena_alloc(void* ctx, const u64 size, const u64 alignment, mem::Slice<u8>* out_block) {
+    VirtualArena* arena = (VirtualArena*)ctx;
+
+    const u64 base = (u64)arena->reserved.ptr;
+    const u64 aligned_index = mem::align_up(base + arena->end_idx, alignment) - base;
+    const u64 aligned_size = mem::align_up(size, alignment);
+    if (aligned_index > arena->reserved.len) return false;
+    if (aligned_size > arena->reserved.len - aligned_index) return false;
+
+    if (!virtual_arena_commit(arena, aligned_index + aligned_size)) return false;
+
+    *out_block = mem::Slice<u8>{ arena->reserved.ptr + aligned_index, size };
+    arena->end_idx = aligned_index + aligned_size;
+
+    return true;
+}
+
+static bool
+virtual_arena_resize(
+    void* ctx,
+    void* ptr,
+    const u64 old_size,
+    const u64 new_size,
+    const u64 alignment
+) {
+    VirtualArena* arena = (VirtualArena*)ctx;
+
+    if (ptr == nullptr) return false;
+    if (!virtual_arena_is_top(arena, ptr, old_size, alignment)) return new_size <= old_size;
+
+    const u64 start_idx = (u64)((u8*)ptr - arena->reserved.ptr);
+    const u64 aligned_size = mem::align_up(new_size, alignment);
+    if (aligned_size > arena->reserved.len - start_idx) return false;
+
+    if (!virtual_arena_commit(arena, start_idx + aligned_size)) return false;
+    arena->end_idx = start_idx + aligned_size;
+
+    return true;
+}
+
+static void
+virtual_arena_free(void* ctx, void* ptr, const u64 size, const u64 alignment) {
+    VirtualArena* arena = (VirtualArena*)ctx;
+
+    if (ptr != nullptr && virtual_arena_is_top(arena, ptr, size, alignment)) {
+        arena->end_idx -= mem::align_up(size, alignment);
+    }
+}
+
+bool
+VirtualArena::init(const u64 reserve_size, VirtualArena* out_arena) {
+    mem::Slice<u8> reserved = {};
+    if (!os_reserve(reserve_size, &reserved)) return false;
+
+    *out_arena = {
+        .reserved = reserved,
+        .committed = 0,
+        .end_idx = 0,
+    };
+
+    return true;
+}
+
+bool
+VirtualArena::init(VirtualArena* out_arena) {
+    return init(DEFAULT_RESERVE_SIZE, out_arena);
+}
+
+mem::Allocator
+VirtualArena::allocator() const {
+    return {
+        .ctx = (void*)this,
+        .vtable = {
+            .alloc_fn = &virtual_arena_alloc,
+            .resize_fn = &virtual_arena_resize,
+            .free_fn = &virtual_arena_free,
+            .remap_fn = nullptr,
+        },
+    };
+}
+
+void
+VirtualArena::reset() {
+    end_idx = 0;
+}
+
+void
+VirtualArena::deinit() {
+    if (reserved.ptr) os_release(reserved.ptr, reserved.len);
+    *this = {};
+}
+
+static void
+tracking_grow(TrackingAllocator::Stats* stats, const u64 old_size, const u64 new_size) {
+    stats->live_bytes = stats->live_bytes - old_size + new_size;
+    stats->peak_bytes = math::max(stats->peak_bytes, stats->live_bytes);
+}
+
+static bool
+tracking_do_alloc(
+    TrackingAllocator* tracker,
+    TrackingAllocator::Stats* tag_stats,
+    const u64 size,
+    const u64 alignment,
+    mem::Slice<u8>* out_block
+) {
+    TrackingAllocator::Stats* all_stats[] = { &tracker->stats, tag_stats };
+    const bool ok = tracker->inner_allocator.raw_alloc(size, alignment, out_block);
+
+    for (TrackingAllocator::Stats* stats : all_stats) {
+        if (stats == nullptr) continue;
+        if (!ok) {
+            ++stats->failed_alloc_count;
+            continue;
+        }
+        ++stats->alloc_count;
+        if (size != 0) ++stats->histogram[bit::log2(size)];
+        tracking_grow(stats, 0, size);
+    }
+
+    return ok;
+}
+
+static bool
+tracking_do_remap(
+    TrackingAllocator* tracker,
+    TrackingAllocator::Stats* tag_stats,
+    void* ptr,
+    const u64 old_size,
+    const u64 new_size,
+    const u64 alignment,
+    void** out_ptr
+) {
+    TrackingAllocator::Stats* all_stats[] = { &tracker->stats, tag_stats };
+    const mem::Allocator inner = tracker->inner_allocator;
+
+    bool ok = false;
+    if (out_ptr && inner.vtable.remap_fn) {
+        ok = inner.vtable.remap_fn(inner.ctx, ptr, old_size, new_size, alignment, out_ptr);
+    } else {
+        ok = inner.vtable.resize_fn(inner.ctx, ptr, old_size, new_size, alignment);
+        if (ok && out_ptr) *out_ptr = ptr;
+    }
+
+    for (TrackingAllocator::Stats* stats : all_stats) {
+        if (stats == nullptr) continue;
+        if (!ok) {
+            ++stats->failed_resize_count;
+            continue;
+        }
+        ++stats->resize_count;
+        tracking_grow(stats, old_size, new_size);
+    }
+
+    return ok;
+}
+
+static void
+tracking_do_free(
+    TrackingAllocator* tracker,
+    TrackingAllocator::Stats* tag_stats,
+    void* ptr,
+    const u64 size,
+    const u64 alignment
+) {
+    TrackingAllocator::Stats* all_stats[] = { &tracker->stats, tag_stats };
+    const mem::Allocator inner = tracker->inner_allocator;
+
+    inner.vtable.free_fn(inner.ctx, ptr, size, alignment);
+
+    if (ptr == nullptr) return;
+    for (TrackingAllocator::Stats* stats : all_stats) {
+        if (stats == nullptr) continue;
+        ++stats->free_count;
+        stats->live_bytes -= size;
+    }
+}
+
+static bool
+tracking_alloc(void* ctx, const u64 size, const u64 alignment, mem::Slice<u8>* out_block) {
+    return tracking_do_alloc((TrackingAllocator*)ctx, nullptr, size, alignment, out_block);
+}
+
+static bool
+tracking_resize(void* ctx, void* ptr, const u64 old_size, const u64 new_size, const u64 alignment) {
+    return tracking_do_remap(
+        (TrackingAllocator*)ctx, nullptr, ptr, old_size, new_size, alignment, nullptr
+    );
+}
+
+static bool
+tracking_remap(
+    void* ctx,
+    void* ptr,
+    const u64 old_size,
+    const u64 new_size,
+    const u64 alignment,
+    void** out_ptr
+) {
+    return tracking_do_remap(
+        (TrackingAllocator*)ctx, nullptr, ptr, old_size, new_size, alignment, out_ptr
+    );
+}
+
+static void
+tracking_free(void* ctx, void* ptr, const u64 size, const u64 alignment) {
+    tracking_do_free((TrackingAllocator*)ctx, nullptr, ptr, size, alignment);
+}
+
+static bool
+tracking_tag_alloc(void* ctx, const u64 size, const u64 alignment, mem::Slice<u8>* out_block) {
+    TrackingAllocator::Tag* tag = (TrackingAllocator::Tag*)ctx;
+    return tracking_do_alloc(tag->owner, &tag->stats, size, alignment, out_block);
+}
+
+static bool
+tracking_tag_resize(
+    void* ctx,
+    void* ptr,
+    const u64 old_size,
+    const u64 new_size,
+    const u64 alignment
+) {
+    TrackingAllocator::Tag* tag = (TrackingAllocator::Tag*)ctx;
+    return tracking_do_remap(tag->owner, &tag->stats, ptr, old_size, new_size, alignment, nullptr);
+}
+
+static bool
+tracking_tag_remap(
+    void* ctx,
+    void* ptr,
+    const u64 old_size,
+    const u64 new_size,
+    const u64 alignment,
+    void** out_ptr
+) {
+    TrackingAllocator::Tag* tag = (TrackingAllocator::Tag*)ctx;
+    return tracking_do_remap(tag->owner, &tag->stats, ptr, old_size, new_size, alignment, out_ptr);
+}
+
+static void
+tracking_tag_free(void* ctx, void* ptr, const u64 size, const u64 alignment) {
+    TrackingAllocator::Tag* tag = (TrackingAllocator::Tag*)ctx;
+    tracking_do_free(tag->owner, &tag->stats, ptr, size, alignment);
+}
+
+static bool
+tracking_print(const Str name, const TrackingAllocator::Stats* stats) {
+    if (!fmt::print_stdout(
+            "{s}: live {u64} B, peak {u64} B, {u64} allocs ({u64} failed), {u64} frees, "
+            "{u64} resizes ({u64} failed)\n",
+            name,
+            stats->live_bytes,
+            stats->peak_bytes,
+            stats->alloc_count,
+            stats->failed_alloc_count,
+            stats->free_count,
+            stats->resize_count,
+            stats->failed_resize_count
+        ))
+        return false;
+
+    for (u64 idx = 0; idx < TrackingAllocator::HISTOGRAM_SIZE; ++idx) {
+        if (stats->histogram[idx] == 0) continue;
+        if (!fmt::print_stdout("    >= 2^{u64} B: {u64}\n", idx, stats->histogram[idx]))
+            return false;
+    }
+
+    return true;
+}
+
+TrackingAllocator
+TrackingAllocator::init(const mem::Allocator inner) {
+    return {
+        .inner_allocator = inner,
+        .stats = {},
+        .tags = {},
+        .tag_count = 0,
+        .pinned = {},
+    };
+}
+
+mem::Allocator
+TrackingAllocator::allocator() const {
+    return {
+        .ctx = (void*)this,
+        .vtable = {
+            .alloc_fn = &tracking_alloc,
+            .resize_fn = &tracking_resize,
+            .free_fn = &tracking_free,
+            .remap_fn = &tracking_remap,
+        },
+    };
+}
+
+bool
+TrackingAllocator::tagged(const Str name, mem::Allocator* out_allocator) {
+    Tag* tag = nullptr;
+    for (u64 idx = 0; idx < tag_count; ++idx) {
+        if (mem::equal(tags[idx].name, name)) tag = &tags[idx];
+    }
+
+    if (tag == nullptr) {
+        if (tag_count == MAX_TAGS) return false;
+        tag = &tags[tag_count++];
+        *tag = {
+            .owner = this,
+            .name = name,
+            .stats = {},
+        };
+    }
+
+    *out_allocator = {
+        .ctx = tag,
+        .vtable = {
+            .alloc_fn = &tracking_tag_alloc,
+            .resize_fn = &tracking_tag_resize,
+            .free_fn = &tracking_tag_free,
+            .remap_fn = &tracking_tag_remap,
+        },
+    };
+
+    return true;
+}
+
+TrackingAllocator::Stats
+TrackingAllocator::snapshot() const {
+    return stats;
+}
+
+bool
+TrackingAllocator::print_stats() const {
+    if (!tracking_print("total", &stats)) return false;
+    for (u64 idx = 0; idx < tag_count; ++idx) {
+        if (!tracking_print(tags[idx].name, &tags[idx].stats)) return false;
+    }
+    return true;
+}
+
+static bool
+fixed_buffer_is_top(
+    const FixedBufferAllocator* fba,
+    const void* ptr,
+    const u64 size,
+    const u64 alignment
+) {
+    const u64 aligned_size = mem::align_up(size, alignment);
+    if (aligned_size > fba->end_idx) return false;
+
+    return (const u8*)ptr == fba->buffer.ptr + fba->end_idx - aligned_size;
+}
+
+static bool
+fixed_buffer_alloc(void* ctx, const u64 size, const u64 alignment, mem::Slice<u8>* out_block) {
+    FixedBufferAllocator* fba = (FixedBufferAllocator*)ctx;
+
+    const u64 base = (u64)fba->buffer.ptr;
+    const u64 aligned_index = mem::align_up(base + fba->end_idx, alignment) - base;
+    const u64 aligned_size = mem::align_up(size, alignment);
+    if (aligned_index > fba->buffer.len) return false;
+    if (aligned_size > fba->buffer.len - aligned_index) return false;
+
+    *out_block = mem::Slice<u8>{ fba->buffer.ptr + aligned_index, size };
+    fba->end_idx = aligned_index + aligned_size;
+
+    return true;
+}
+
+static bool
+fixed_buffer_resize(
+    void* ctx,
+    void* ptr,
+    const u64 old_size,
+    const u64 new_size,
+    const u64 alignment
+) {
+    FixedBufferAllocator* fba = (FixedBufferAllocator*)ctx;
+
+    if (ptr == nullptr) return false;
+    if (!fixed_buffer_is_top(fba, ptr, old_size, alignment)) return new_size <= old_size;
+
+    const u64 start_idx = (u64)((u8*)ptr - fba->buffer.ptr);
+    const u64 aligned_size = mem::align_up(new_size, alignment);
+    if (aligned_size > fba->buffer.len - start_idx) return false;
+
+    fba->end_idx = start_idx + aligned_size;
+
+    return true;
+}
+
+static void
+fixed_buffer_free(void* ctx, void* ptr, const u64 size, const u64 alignment) {
+    FixedBufferAllocator* fba = (FixedBufferAllocator*)ctx;
+
+    if (ptr != nullptr && fixed_buffer_is_top(fba, ptr, size, alignment)) {
+        fba->end_idx -= mem::align_up(size, alignment);
+    }
+}
+
+FixedBufferAllocator
+FixedBufferAllocator::init(const mem::Slice<u8> buffer) {
+    return {
+        .buffer = buffer,
+        .end_idx = 0,
+    };
+}
+
+mem::Allocator
+FixedBufferAllocator::allocator() const {
+    return {
+        .ctx = (void*)this,
+        .vtable = {
+            .alloc_fn = &fixed_buffer_alloc,
+            .resize_fn = &fixed_buffer_resize,
+            .free_fn = &fixed_buffer_free,
+            .remap_fn = nullptr,
+        },
+    };
+}
+
+void
+FixedBufferAllocator::reset() {
+    end_idx = 0;
+}
+
+static void
+concurrent_arena_free_chunk(ConcurrentArena* arena, ConcurrentArena::Chunk* chunk) {
+    const mem::Allocator inner = arena->inner_allocator;
+    inner.vtable.free_fn(
+        inner.ctx,
+        chunk,
+        sizeof(ConcurrentArena::Chunk) + chunk->capacity,
+        alignof(ConcurrentArena::Chunk)
+    );
+}
+
+static bool
+concurrent_arena_alloc(void* ctx, const u64 size, const u64 alignment, mem::Slice<u8>* out_block) {
+    ConcurrentArena* arena = (ConcurrentArena*)ctx;
+
+    const u64 padding = alignment > ConcurrentArena::BASE_ALIGNMENT ? alignment - 1 : 0;
+    const u64 needed = mem::align_up(size + padding, ConcurrentArena::BASE_ALIGNMENT);
+
+    ConcurrentArena::Chunk* chunk = atomic::load(&arena->current);
+    while (true) {
+        if (chunk) {
+            const u64 offset = atomic::fetch_add(&chunk->offset, needed);
+            if (offset <= chunk->capacity && needed <= chunk->capacity - offset) {
+                u8* data = (u8*)(chunk + 1) + offset;
+                data = (u8*)mem::align_up((u64)data, alignment);
+                *out_block = mem::Slice<u8>{ data, size };
+                return true;
+            }
+        }
+
+        // The chunk is full, install a bigger one unless another thread already did
+        const u64 prev_capacity = chunk ? chunk->capacity : 0;
+        const u64 capacity = math::max(
+            math::max(needed, ConcurrentArena::MIN_CHUNK_SIZE),
+            math::min(prev_capacity * 2, ConcurrentArena::MAX_CHUNK_SIZE)
+        );
+
+        mem::Slice<u8> block = {};
+        if (!arena->inner_allocator.raw_alloc(
+                sizeof(ConcurrentArena::Chunk) + capacity, alignof(ConcurrentArena::Chunk), &block
+            ))
+            return false;
+
+        ConcurrentArena::Chunk* new_chunk = (ConcurrentArena::Chunk*)block.ptr;
+        new_chunk->next = chunk;
+        new_chunk->capacity = capacity;
+        new_chunk->offset = needed;
+
+        ConcurrentArena::Chunk* expected = chunk;
+        if (atomic::compare_exchange(&arena->current, &expected, new_chunk)) {
+            u8* data = (u8*)mem::align_up((u64)(new_chunk + 1), alignment);
+            *out_block = mem::Slice<u8>{ data, size };
+            return true;
+        }
+
+        // Lost the race, retry with the chunk that won
+        concurrent_arena_free_chunk(arena, new_chunk);
+        chunk = expected;
+    }
+}
+
+static bool
+concurrent_arena_resize(
+    void* ctx,
+    void* ptr,
+    const u64 old_size,
+    const u64 new_size,
+    const u64 alignment
+) {
+    (void)ctx;
+    (void)alignment;
+
+    // Other threads may have allocated past the block, only shrinking is possible
+    return ptr != nullptr && new_size <= old_size;
+}
+
+static void
+concurrent_arena_free(void* ctx, void* ptr, const u64 size, const u64 alignment) {
+    (void)ctx;
+    (void)ptr;
+    (void)size;
+    (void)alignment;
+}
+
+ConcurrentArena
+ConcurrentArena::init(const mem::Allocator inner) {
+    return {
+        .inner_allocator = inner,
+        .current = nullptr,
+    };
+}
+
+mem::Allocator
+ConcurrentArena::allocator() const {
+    return {
+        .ctx = (void*)this,
+        .vtable = {
+            .alloc_fn = &concurrent_arena_alloc,
+            .resize_fn = &concurrent_arena_resize,
+            .free_fn = &concurrent_arena_free,
+            .remap_fn = nullptr,
+        },
+    };
+}
+
+void
+ConcurrentArena::reset() {
+    if (current == nullptr) return;
+
+    Chunk* chunk = current->next;
+    while (chunk) {
+        Chunk* next = chunk->next;
+        concurrent_arena_free_chunk(this, chunk);
+        chunk = next;
+    }
+
+    current->next = nullptr;
+    current->offset = 0;
+}
+
+void
+ConcurrentArena::deinit() {
+    Chunk* chunk = current;
+    while (chunk) {
+        Chunk* next = chunk->next;
+        concurrent_arena_free_chunk(this, chunk);
+        chunk = next;
+    }
+    current = nullptr;
+}
+
+static u64
+buddy_block_size(const u64 level) {
+    return BuddyAllocator::MIN_BLOCK_SIZE << level;
+}
+
+// Smallest level whose blocks fit size bytes aligned to alignment
+static u64
+buddy_level(const BuddyAllocator* buddy, const u64 size, const u64 alignment) {
+    const u64 len = math::max(size, alignment);
+
+    u64 level = 0;
+    while (level < buddy->level_count && buddy_block_size(level) < len) ++level;
+
+    return level;
+}
+
+static u64
+buddy_index(const BuddyAllocator* buddy, const void* ptr, const u64 level) {
+    return (u64)((const u8*)ptr - buddy->region.ptr) / buddy_block_size(level);
+}
+
+static u8*
+buddy_address(const BuddyAllocator* buddy, const u64 index, const u64 level) {
+    return buddy->region.ptr + index * buddy_block_size(level);
+}
+
+// Position of the first bit of level in free_bits
+static u64
+buddy_bit_offset(const BuddyAllocator* buddy, const u64 level) {
+    const u64 min_block_count = buddy->region.len / BuddyAllocator::MIN_BLOCK_SIZE;
+    return 2 * min_block_count - ((2 * min_block_count) >> level);
+}
+
+static bool
+buddy_is_free(const BuddyAllocator* buddy, const u64 index, const u64 level) {
+    const u64 bit = buddy_bit_offset(buddy, level) + index;
+    return (buddy->free_bits.ptr[bit / 64] >> (bit % 64)) & 1;
+}
+
+static void
+buddy_push(BuddyAllocator* buddy, const u64 index, const u64 level) {
+    BuddyAllocator::FreeBlock* block =
+        (BuddyAllocator::FreeBlock*)buddy_address(buddy, index, level);
+    block->prev = nullptr;
+    block->next = buddy->free_lists[level];
+    if (block->next) block->next->prev = block;
+    buddy->free_lists[level] = block;
+
+    const u64 bit = buddy_bit_offset(buddy, level) + index;
+    buddy->free_bits.ptr[bit / 64] |= (u64)1 << (bit % 64);
+}
+
+static void
+buddy_remove(BuddyAllocator* buddy, const u64 index, const u64 level) {
+    BuddyAllocator::FreeBlock* block =
+        (BuddyAllocator::FreeBlock*)buddy_address(buddy, index, level);
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        buddy->free_lists[level] = block->next;
+    }
+    if (block->next) block->next->prev = block->prev;
+
+    const u64 bit = buddy_bit_offset(buddy, level) + index;
+    buddy->free_bits.ptr[bit / 64] &= ~((u64)1 << (bit % 64));
+}
+
+// Gives the upper halves of a block back until it is down to level
+static void
+buddy_split(BuddyAllocator* buddy, u64 index, u64 from_level, const u64 level) {
+    while (from_level > level) {
+        --from_level;
+        index *= 2;
+        buddy_push(buddy, index + 1, from_level);
+    }
+}
+
+static bool
+buddy_alloc(void* ctx, const u64 size, const u64 alignment, mem::Slice<u8>* out_block) {
+    BuddyAllocator* buddy = (BuddyAllocator*)ctx;
+
+    // Blocks are aligned to their size relative to the start of the region
+    if ((u64)buddy->region.ptr % alignment != 0) return false;
+
+    const u64 level = buddy_level(buddy, size, alignment);
+    if (level >= buddy->level_count) return false;
+
+    u64 free_level = level;
+    while (free_level < buddy->level_count && buddy->free_lists[free_level] == nullptr) {
+        ++free_level;
+    }
+    if (free_level == buddy->level_count) return false;
+
+    const u64 index = buddy_index(buddy, buddy->free_lists[free_level], free_level);
+    buddy_remove(buddy, index, free_level);
+    buddy_split(buddy, index, free_level, level);
+
+    *out_block = mem::Slice<u8>{ buddy_address(buddy, index << (free_level - level), level), size };
+
+    return true;
+}
+
+static bool
+buddy_resize(void* ctx, void* ptr, const u64 old_size, const u64 new_size, const u64 alignment) {
+    BuddyAllocator* buddy = (BuddyAllocator*)ctx;
+
+    if (ptr == nullptr) return false;
+
+    const u64 old_level = buddy_level(buddy, old_size, alignment);
+    const u64 new_level = buddy_level(buddy, new_size, alignment);
+    if (new_level >= buddy->level_count) return false;
+
+    const u64 index = buddy_index(buddy, ptr, old_level);
+    if (new_level <= old_level) {
+        buddy_split(buddy, index, old_level, new_level);
+        return true;
+    }
+
+    // Every level up, the block must be the left half and its right buddy must be free
+    u64 level_index = index;
+    for (u64 level = old_level; level < new_level; ++level) {
+        if (level_index % 2 != 0 || !buddy_is_free(buddy, level_index + 1, level)) return false;
+        level_index /= 2;
+    }
+
+    level_index = index;
+    for (u64 level = old_level; level < new_level; ++level) {
+        buddy_remove(buddy, level_index + 1, level);
+        level_index /= 2;
+    }
+
+    return true;
+}
+
+static void
+buddy_free(void* ctx, void* ptr, const u64 size, const u64 alignment) {
+    BuddyAllocator* buddy = (BuddyAllocator*)ctx;
+
+    if (ptr == nullptr) return;
+
+    u64 level = buddy_level(buddy, size, alignment);
+    u64 index = buddy_index(buddy, ptr, level);
+
+    while (level + 1 < buddy->level_count && buddy_is_free(buddy, index ^ 1, level)) {
+        buddy_remove(buddy, index ^ 1, level);
+        index /= 2;
+        ++level;
+    }
+
+    buddy_push(buddy, index, level);
+}
+
+bool
+BuddyAllocator::init(const mem::Allocator inner, const u64 size, BuddyAllocator* out_allocator) {
+    u64 level_count = 1;
+    while (buddy_block_size(level_count - 1) < size) {
+        if (level_count == MAX_LEVELS) return false;
+        ++level_count;
+    }
+
+    const u64 region_size = buddy_block_size(level_count - 1);
+    const u64 bit_count = 2 * (region_size / MIN_BLOCK_SIZE);
+
+    BuddyAllocator buddy = {
+        .inner_allocator = inner,
+        .region = {},
+        .free_bits = {},
+        .level_count = level_count,
+        .free_lists = {},
+    };
+
+    if (!inner.raw_alloc(region_size, MIN_BLOCK_SIZE, &buddy.region)) return false;
+    buddy.region.len = region_size;
+
+    if (!inner.alloc(mem::align_up(bit_count, (u64)64) / 64, &buddy.free_bits)) {
+        inner.vtable.free_fn(inner.ctx, buddy.region.ptr, region_size, MIN_BLOCK_SIZE);
+        return false;
+    }
+    mem::zero(buddy.free_bits);
+
+    buddy_push(&buddy, 0, level_count - 1);
+
+    *out_allocator = buddy;
+
+    return true;
+}
+
+mem::Allocator
+BuddyAllocator::allocator() const {
+    return {
+        .ctx = (void*)this,
+        .vtable = {
+            .alloc_fn = &buddy_alloc,
+            .resize_fn = &buddy_resize,
+            .free_fn = &buddy_free,
+            .remap_fn = nullptr,
+        },
+    };
+}
+
+void
+BuddyAllocator::deinit() {
+    inner_allocator.vtable.free_fn(inner_allocator.ctx, region.ptr, region.len, MIN_BLOCK_SIZE);
+    inner_allocator.free(free_bits);
+    *this = {};
+}
+
+// Bin whose smallest size is <= size
+static u32
+offset_bin_round_down(const u64 size) {
+    if (size < OffsetAllocator::LEAF_BIN_COUNT) return (u32)size;
+
+    const u32 mantissa_start = bit::log2(size) - OffsetAllocator::MANTISSA_BITS;
+    const u32 exponent = mantissa_start + 1;
+    const u32 mantissa = (u32)(size >> mantissa_start) & (OffsetAllocator::LEAF_BIN_COUNT - 1);
+
+    return (exponent << OffsetAllocator::MANTISSA_BITS) | mantissa;
+}
+
+// Bin whose smallest size is >= size
+static u32
+offset_bin_round_up(const u64 size) {
+    if (size < OffsetAllocator::LEAF_BIN_COUNT) return (u32)size;
+
+    const u32 mantissa_start = bit::log2(size) - OffsetAllocator::MANTISSA_BITS;
+    const u64 low_bits = size & (((u64)1 << mantissa_start) - 1);
+
+    // A carry out of the mantissa correctly bumps the exponent
+    return offset_bin_round_down(size) + (low_bits != 0 ? 1 : 0);
+}
+
+// First bin at or after bin that has a free node, NONE if there is none
+static u32
+offset_find_bin(const OffsetAllocator* oa, const u32 bin) {
+    u32 top = bin >> OffsetAllocator::MANTISSA_BITS;
+    const u32 leaf = bin & (OffsetAllocator::LEAF_BIN_COUNT - 1);
+
+    if (top >= OffsetAllocator::TOP_BIN_COUNT) return OffsetAllocator::NONE;
+
+    const u32 leaf_mask = (u32)oa->used_leaf_bins[top] & (0xFFu << leaf);
+    if (leaf_mask != 0) {
+        return (top << OffsetAllocator::MANTISSA_BITS) | bit::ctz(leaf_mask);
+    }
+
+    if (top + 1 >= OffsetAllocator::TOP_BIN_COUNT) return OffsetAllocator::NONE;
+    const u64 top_mask = oa->used_top_bins & (~(u64)0 << (top + 1));
+    if (top_mask == 0) return OffsetAllocator::NONE;
+
+    top = bit::ctz(top_mask);
+    return (top << OffsetAllocator::MANTISSA_BITS) |
+           bit::ctz(oa->used_leaf_bins[top]);
+}
+
+static u32
+offset_insert_free(OffsetAllocator* oa, const u64 offset, const u64 size) {
+    const u32 bin = offset_bin_round_down(size);
+    const u32 top = bin >> OffsetAllocator::MANTISSA_BITS;
+    const u32 leaf = bin & (OffsetAllocator::LEAF_BIN_COUNT - 1);
+
+    if (oa->bin_heads[bin] == OffsetAllocator::NONE) {
+        oa->used_leaf_bins[top] |= (u8)(1u << leaf);
+        oa->used_top_bins |= (u64)1 << top;
+    }
+
+    assert(oa->free_node_count > 0);
+    const u32 idx = oa->free_nodes.ptr[--oa->free_node_count];
+    const u32 head = oa->bin_heads[bin];
+    oa->nodes.ptr[idx] = {
+        .offset = offset,
+        .size = size,
+        .bin_prev = OffsetAllocator::NONE,
+        .bin_next = head,
+        .neighbor_prev = OffsetAllocator::NONE,
+        .neighbor_next = OffsetAllocator::NONE,
+        .used = false,
+    };
+    if (head != OffsetAllocator::NONE) oa->nodes.ptr[head].bin_prev = idx;
+    oa->bin_heads[bin] = idx;
+
+    oa->free_storage += size;
+
+    return idx;
+}
+
+// Unlinks a free node from its bin, the node itself stays allocated
+static void
+offset_unlink_free(OffsetAllocator* oa, const u32 idx) {
+    OffsetAllocator::Node* node = &oa->nodes.ptr[idx];
+
+    if (node->bin_prev != OffsetAllocator::NONE) {
+        oa->nodes.ptr[node->bin_prev].bin_next = node->bin_next;
+    } else {
+        const u32 bin = offset_bin_round_down(node->size);
+        oa->bin_heads[bin] = node->bin_next;
+
+        if (node->bin_next == OffsetAllocator::NONE) {
+            const u32 top = bin >> OffsetAllocator::MANTISSA_BITS;
+            const u32 leaf = bin & (OffsetAllocator::LEAF_BIN_COUNT - 1);
+            oa->used_leaf_bins[top] &= (u8) ~(1u << leaf);
+            if (oa->used_leaf_bins[top] == 0) oa->used_top_bins &= ~((u64)1 << top);
+        }
+    }
+    if (node->bin_next != OffsetAllocator::NONE) {
+        oa->nodes.ptr[node->bin_next].bin_prev = node->bin_prev;
+    }
+
+    oa->free_storage -= node->size;
+}
+
+static void
+offset_release_node(OffsetAllocator* oa, const u32 idx) {
+    oa->free_nodes.ptr[oa->free_node_count++] = idx;
+}
+
+bool
+OffsetAllocator::init(
+    const mem::Allocator metadata_allocator,
+    const u64 size,
+    const u32 max_allocs,
+    OffsetAllocator* out_allocator
+) {
+    OffsetAllocator oa = {
+        .metadata_allocator = metadata_allocator,
+        .size = size,
+        .free_storage = 0,
+        .used_top_bins = 0,
+        .used_leaf_bins = {},
+        .bin_heads = {},
+        .nodes = {},
+        .free_nodes = {},
+        .free_node_count = 0,
+    };
+
+    if (!metadata_allocator.alloc(max_allocs, &oa.nodes)) return false;
+    if (!metadata_allocator.alloc(max_allocs, &oa.free_nodes)) {
+        metadata_allocator.free(oa.nodes);
+        return false;
+    }
+
+    oa.reset();
+    *out_allocator = oa;
+
+    return true;
+}
+
+bool
+OffsetAllocator::alloc(const u64 alloc_size, Allocation* out_allocation) {
+    if (alloc_size == 0) return false;
+    // The remainder of the split needs its own node
+    if (free_node_count < 1) return false;
+
+    const u32 bin = offset_find_bin(this, offset_bin_round_up(alloc_size));
+    if (bin == NONE) return false;
+
+    const u32 idx = bin_heads[bin];
+    offset_unlink_free(this, idx);
+
+    Node* node = &nodes.ptr[idx];
+    const u64 remainder = node->size - alloc_size;
+    node->size = alloc_size;
+    node->used = true;
+
+    if (remainder > 0) {
+        const u32 new_idx = offset_insert_free(this, node->offset + alloc_size, remainder);
+        node = &nodes.ptr[idx];
+
+        Node* new_node = &nodes.ptr[new_idx];
+        new_node->neighbor_prev = idx;
+        new_node->neighbor_next = node->neighbor_next;
+        if (node->neighbor_next != NONE) nodes.ptr[node->neighbor_next].neighbor_prev = new_idx;
+        node->neighbor_next = new_idx;
+    }
+
+    *out_allocation = {
+        .offset = node->offset,
+        .metadata = idx,
+    };
+
+    return true;
+}
+
+void
+OffsetAllocator::free(const Allocation allocation) {
+    assert(allocation.metadata < nodes.len);
+    Node node = nodes.ptr[allocation.metadata];
+    assert(node.used);
+
+    // Merge with free neighbors, their nodes are given back
+    if (node.neighbor_prev != NONE && !nodes.ptr[node.neighbor_prev].used) {
+        const u32 prev_idx = node.neighbor_prev;
+        const Node prev = nodes.ptr[prev_idx];
+        offset_unlink_free(this, prev_idx);
+        offset_release_node(this, prev_idx);
+
+        node.offset = prev.offset;
+        node.size += prev.size;
+        node.neighbor_prev = prev.neighbor_prev;
+    }
+
+    if (node.neighbor_next != NONE && !nodes.ptr[node.neighbor_next].used) {
+        const u32 next_idx = node.neighbor_next;
+        const Node next = nodes.ptr[next_idx];
+        offset_unlink_free(this, next_idx);
+        offset_release_node(this, next_idx);
+
+        node.size += next.size;
+        node.neighbor_next = next.neighbor_next;
+    }
+
+    offset_release_node(this, allocation.metadata);
+
+    const u32 idx = offset_insert_free(this, node.offset, node.size);
+    nodes.ptr[idx].neighbor_prev = node.neighbor_prev;
+    nodes.ptr[idx].neighbor_next = node.neighbor_next;
+    if (node.neighbor_prev != NONE) nodes.ptr[node.neighbor_prev].neighbor_next = idx;
+    if (node.neighbor_next != NONE) nodes.ptr[node.neighbor_next].neighbor_prev = idx;
+}
+
+void
+OffsetAllocator::reset() {
+    free_storage = 0;
+    used_top_bins = 0;
+    for (auto& leaf : used_leaf_bins) leaf = 0;
+    for (auto& head : bin_heads) head = NONE;
+
+    // Pop order is 0, 1, 2...
+    free_node_count = (u32)free_nodes.len;
+    for (u32 idx = 0; idx < free_node_count; ++idx) {
+        free_nodes.ptr[idx] = free_node_count - idx - 1;
+    }
+
+    if (free_node_count > 0 && size > 0) offset_insert_free(this, 0, size);
+}
+
+void
+OffsetAllocator::deinit() {
+    metadata_allocator.free(nodes);
+    metadata_allocator.free(free_nodes);
+    *this = {};
 }
 
 } // namespace heap
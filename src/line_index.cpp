@@ -0,0 +1,155 @@
+#include "line_index.hpp"
+
+#include "bit.hpp"
+#include "math.hpp"
+#include "simd.hpp"
+#include "thread.hpp"
+
+namespace mksv {
+namespace lines {
+
+// Below this many bytes per thread, spawning costs more than the scan
+constexpr u64 MIN_PARALLEL_CHUNK = math::mega_bytes((u64)1);
+
+static u64
+count_newlines(const Str text) {
+    u64 count = 0;
+    u64 idx = 0;
+
+#if ARCH_X64
+    const simd::U8x newline = simd::splat('\n');
+    for (; idx + simd::WIDTH <= text.len; idx += simd::WIDTH) {
+        count += bit::pop_count(simd::movemask(simd::cmpeq(simd::load(text.ptr + idx), newline)));
+    }
+#endif
+
+    for (; idx < text.len; ++idx) count += text.ptr[idx] == '\n';
+
+    return count;
+}
+
+// out has room for every newline of text, returns one past the last written offset
+static u64*
+write_newlines(const Str text, const u64 base_offset, u64* out) {
+    u64 idx = 0;
+
+#if ARCH_X64
+    const simd::U8x newline = simd::splat('\n');
+    for (; idx + simd::WIDTH <= text.len; idx += simd::WIDTH) {
+        u32 mask = simd::movemask(simd::cmpeq(simd::load(text.ptr + idx), newline));
+        while (mask != 0) {
+            *out++ = base_offset + idx + bit::ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; idx < text.len; ++idx) {
+        if (text.ptr[idx] == '\n') *out++ = base_offset + idx;
+    }
+
+    return out;
+}
+
+bool
+build_index(const Str text, ArrayList<u64>* out_offsets) {
+    u64 idx = 0;
+
+#if ARCH_X64
+    const simd::U8x newline = simd::splat('\n');
+    for (; idx + simd::WIDTH <= text.len; idx += simd::WIDTH) {
+        u32 mask = simd::movemask(simd::cmpeq(simd::load(text.ptr + idx), newline));
+        if (mask == 0) continue;
+
+        if (!out_offsets->ensure_capacity(bit::pop_count(mask))) return false;
+
+        u64* out = out_offsets->items.ptr + out_offsets->size;
+        while (mask != 0) {
+            *out++ = idx + bit::ctz(mask);
+            mask &= mask - 1;
+        }
+        out_offsets->size = (u64)(out - out_offsets->items.ptr);
+    }
+#endif
+
+    for (; idx < text.len; ++idx) {
+        if (text.ptr[idx] == '\n' && !out_offsets->append(idx)) return false;
+    }
+
+    return true;
+}
+
+struct ParallelIndex {
+    Str text;
+    u64 chunk_size;
+    u64 counts[thread::MAX_TASKS];
+    // Where each chunk writes its offsets, set once every chunk is counted
+    u64* outputs[thread::MAX_TASKS];
+};
+
+static Str
+chunk(const ParallelIndex* index, const u32 task_index) {
+    const u64 start = math::min(index->text.len, task_index * index->chunk_size);
+    const u64 end = math::min(index->text.len, start + index->chunk_size);
+    return index->text.sub(start, end);
+}
+
+static void
+count_task(void* ctx, const u32 task_index) {
+    ParallelIndex* index = (ParallelIndex*)ctx;
+    index->counts[task_index] = count_newlines(chunk(index, task_index));
+}
+
+static void
+write_task(void* ctx, const u32 task_index) {
+    ParallelIndex* index = (ParallelIndex*)ctx;
+    const Str text = chunk(index, task_index);
+    write_newlines(text, (u64)(text.ptr - index->text.ptr), index->outputs[task_index]);
+}
+
+bool
+build_index_parallel(const Str text, const u32 thread_count, ArrayList<u64>* out_offsets) {
+    u64 task_count = thread_count == 0 ? thread::cpu_count() : thread_count;
+    task_count = math::min(task_count, (u64)thread::MAX_TASKS);
+    task_count = math::min(task_count, text.len / MIN_PARALLEL_CHUNK);
+    if (task_count <= 1) return build_index(text, out_offsets);
+
+    ParallelIndex index = {
+        .text = text,
+        .chunk_size = (text.len + task_count - 1) / task_count,
+        .counts = {},
+        .outputs = {},
+    };
+
+    thread::run_parallel((u32)task_count, count_task, &index);
+
+    u64 total = 0;
+    for (u64 i = 0; i < task_count; ++i) total += index.counts[i];
+
+    if (!out_offsets->ensure_capacity(total)) return false;
+
+    u64* out = out_offsets->items.ptr + out_offsets->size;
+    for (u64 i = 0; i < task_count; ++i) {
+        index.outputs[i] = out;
+        out += index.counts[i];
+    }
+
+    thread::run_parallel((u32)task_count, write_task, &index);
+
+    out_offsets->size += total;
+
+    return true;
+}
+
+Str
+line_at(const Str text, const mem::Slice<u64> newlines, const u64 n) {
+    assert(n <= newlines.len);
+
+    const u64 start = n == 0 ? 0 : newlines[n - 1] + 1;
+    const u64 end = n == newlines.len ? text.len : newlines[n];
+
+    return text.sub(start, end);
+}
+
+} // namespace lines
+} // namespace mksv
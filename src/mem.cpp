@@ -1,8 +1,414 @@
 #include "mem.hpp"
 
+#include "bit.hpp"
+#include "simd.hpp"
+
 namespace mksv {
-namespace mem {}
+namespace mem {
+
+// Bigger copies and fills bypass the cache, they would evict everything anyway
+constexpr u64 NON_TEMPORAL_THRESHOLD = math::mega_bytes((u64)4);
+
+// Forward copy, safe when dst is before src. The last block is loaded up front so overlapping
+// stores can't clobber it
+static void
+copy_forward(u8* dst, const u8* src, const u64 len) {
+#if ARCH_X64
+    if (len >= simd::WIDTH) {
+        const simd::U8x tail = simd::load(src + len - simd::WIDTH);
+
+        u64 idx = 0;
+        if (len >= NON_TEMPORAL_THRESHOLD && (src + len <= dst || dst + len <= src)) {
+            // Unaligned head, then aligned streaming stores
+            simd::store(dst, simd::load(src));
+            idx = mem::align_up((u64)dst, simd::WIDTH) - (u64)dst;
+            for (; idx + simd::WIDTH <= len; idx += simd::WIDTH) {
+                simd::store_stream(dst + idx, simd::load(src + idx));
+            }
+            simd::store_fence();
+        }
+
+        for (; idx + simd::WIDTH <= len; idx += simd::WIDTH) {
+            simd::store(dst + idx, simd::load(src + idx));
+        }
+        simd::store(dst + len - simd::WIDTH, tail);
+        return;
+    }
+#endif
+
+    for (u64 idx = 0; idx < len; ++idx) dst[idx] = src[idx];
+}
+
+// Backward copy, safe when dst is after src
+static void
+copy_backward(u8* dst, const u8* src, const u64 len) {
+#if ARCH_X64
+    if (len >= simd::WIDTH) {
+        const simd::U8x head = simd::load(src);
+
+        u64 idx = len;
+        for (; idx >= simd::WIDTH; idx -= simd::WIDTH) {
+            simd::store(dst + idx - simd::WIDTH, simd::load(src + idx - simd::WIDTH));
+        }
+        simd::store(dst, head);
+        return;
+    }
+#endif
+
+    for (u64 idx = len; idx > 0; --idx) dst[idx - 1] = src[idx - 1];
+}
+
+void
+copy_bytes(const Slice<u8> dst, const Slice<u8> src) {
+    assert(dst.len == src.len);
+    copy_forward(dst.ptr, src.ptr, dst.len);
+}
+
+void
+move_bytes(const Slice<u8> dst, const Slice<u8> src) {
+    assert(dst.len == src.len);
+    if (dst.ptr == src.ptr) return;
+
+    if (dst.ptr < src.ptr) {
+        copy_forward(dst.ptr, src.ptr, dst.len);
+    } else {
+        copy_backward(dst.ptr, src.ptr, dst.len);
+    }
+}
+
+void
+zero_bytes(const Slice<u8> dst) {
+    u64 idx = 0;
+
+#if ARCH_X64
+    if (dst.len >= simd::WIDTH) {
+        const simd::U8x zero = simd::zero();
+
+        if (dst.len >= NON_TEMPORAL_THRESHOLD) {
+            simd::store(dst.ptr, zero);
+            idx = mem::align_up((u64)dst.ptr, simd::WIDTH) - (u64)dst.ptr;
+            for (; idx + simd::WIDTH <= dst.len; idx += simd::WIDTH) {
+                simd::store_stream(dst.ptr + idx, zero);
+            }
+            simd::store_fence();
+        }
+
+        for (; idx + simd::WIDTH <= dst.len; idx += simd::WIDTH) {
+            simd::store(dst.ptr + idx, zero);
+        }
+        simd::store(dst.ptr + dst.len - simd::WIDTH, zero);
+        return;
+    }
+#endif
+
+    for (; idx < dst.len; ++idx) dst.ptr[idx] = 0;
+}
+
+bool
+equal_bytes(const Slice<u8> a, const Slice<u8> b) {
+    if (a.len != b.len) return false;
+
+    u64 idx = 0;
+
+#if ARCH_X64
+    if (a.len >= simd::WIDTH) {
+        for (; idx + simd::WIDTH <= a.len; idx += simd::WIDTH) {
+            const simd::U8x eq = simd::cmpeq(simd::load(a.ptr + idx), simd::load(b.ptr + idx));
+            if (simd::movemask(eq) != simd::FULL_MASK) return false;
+        }
+
+        const u64 last = a.len - simd::WIDTH;
+        const simd::U8x eq = simd::cmpeq(simd::load(a.ptr + last), simd::load(b.ptr + last));
+        return simd::movemask(eq) == simd::FULL_MASK;
+    }
+#endif
+
+    for (; idx < a.len; ++idx) {
+        if (a.ptr[idx] != b.ptr[idx]) return false;
+    }
+
+    return true;
+}
+
+// Needles longer than this use Two-Way, the vector filter degrades on repetitive input
+constexpr u64 SIMD_MAX_NEEDLE = 32;
+
+static bool
+bytes_equal(const u8* a, const u8* b, const u64 len) {
+    return equal_bytes(Slice<u8>{ (u8*)a, len }, Slice<u8>{ (u8*)b, len });
+}
+
+// Reads bytes front to back, or back to front when backward is set. Two-Way over backward views
+// finds the last occurrence
+template <bool backward>
+struct ByteView {
+    const u8* ptr;
+    i64 len;
+
+    u8
+    operator[](const i64 idx) const {
+        return backward ? ptr[len - 1 - idx] : ptr[idx];
+    }
+};
+
+template <bool backward>
+static bool
+view_prefix_equal(const ByteView<backward> view, const i64 offset, const i64 len) {
+    if constexpr (!backward) return bytes_equal(view.ptr, view.ptr + offset, (u64)len);
+
+    for (i64 i = 0; i < len; ++i) {
+        if (view[i] != view[i + offset]) return false;
+    }
+
+    return true;
+}
+
+// Position of the maximal suffix of needle and its period. reversed flips the byte ordering
+template <bool backward>
+static i64
+max_suffix(const ByteView<backward> needle, const bool reversed, i64* out_period) {
+    const i64 len = needle.len;
+    i64 suffix = -1;
+    i64 j = 0;
+    i64 k = 1;
+    i64 period = 1;
+
+    while (j + k < len) {
+        const u8 a = needle[j + k];
+        const u8 b = needle[suffix + k];
+        if (reversed ? a > b : a < b) {
+            j += k;
+            k = 1;
+            period = j - suffix;
+        } else if (a == b) {
+            if (k != period) {
+                ++k;
+            } else {
+                j += period;
+                k = 1;
+            }
+        } else {
+            suffix = j;
+            j = suffix + 1;
+            k = 1;
+            period = 1;
+        }
+    }
+
+    *out_period = period;
+
+    return suffix;
+}
+
+// Crochemore-Perrin Two-Way, O(n + m) time and O(1) space. out_idx is a position in the view
+template <bool backward>
+static bool
+two_way_find(const ByteView<backward> y, const ByteView<backward> x, u64* out_idx) {
+    const i64 m = x.len;
+    const i64 n = y.len;
+
+    i64 p = 0;
+    i64 q = 0;
+    const i64 i_suffix = max_suffix(x, false, &p);
+    const i64 j_suffix = max_suffix(x, true, &q);
+    const i64 ell = i_suffix > j_suffix ? i_suffix : j_suffix;
+    i64 period = i_suffix > j_suffix ? p : q;
+
+    if (view_prefix_equal(x, period, ell + 1)) {
+        // Periodic needle, remember how much of the left part already matched
+        i64 j = 0;
+        i64 memory = -1;
+        while (j <= n - m) {
+            i64 i = math::max(ell, memory) + 1;
+            while (i < m && x[i] == y[i + j]) ++i;
+            if (i >= m) {
+                i = ell;
+                while (i > memory && x[i] == y[i + j]) --i;
+                if (i <= memory) {
+                    *out_idx = (u64)j;
+                    return true;
+                }
+                j += period;
+                memory = m - period - 1;
+            } else {
+                j += i - ell;
+                memory = -1;
+            }
+        }
+    } else {
+        period = math::max(ell + 1, m - ell - 1) + 1;
+        i64 j = 0;
+        while (j <= n - m) {
+            i64 i = ell + 1;
+            while (i < m && x[i] == y[i + j]) ++i;
+            if (i >= m) {
+                i = ell;
+                while (i >= 0 && x[i] == y[i + j]) --i;
+                if (i < 0) {
+                    *out_idx = (u64)j;
+                    return true;
+                }
+                j += period;
+            } else {
+                j += i - ell;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool
+find_bytes(const Slice<u8> haystack, const Slice<u8> needle, u64* out_idx) {
+    if (needle.len > haystack.len) return false;
+    if (haystack.len == 0 || needle.len == 0) return false;
+
+    if (needle.len > SIMD_MAX_NEEDLE) {
+        return two_way_find(
+            ByteView<false>{ haystack.ptr, (i64)haystack.len },
+            ByteView<false>{ needle.ptr, (i64)needle.len },
+            out_idx
+        );
+    }
+
+    const u64 last_start = haystack.len - needle.len;
+    u64 idx = 0;
+
+#if ARCH_X64
+    // Compare the first and last needle bytes against a block of candidates at once, only
+    // candidates matching both are checked in full
+    const simd::U8x first = simd::splat(needle.ptr[0]);
+    const simd::U8x last = simd::splat(needle.ptr[needle.len - 1]);
+    for (; idx + simd::WIDTH <= last_start + 1; idx += simd::WIDTH) {
+        const simd::U8x block_first = simd::load(haystack.ptr + idx);
+        const simd::U8x block_last = simd::load(haystack.ptr + idx + needle.len - 1);
+        u32 mask = simd::movemask(
+            simd::bit_and(simd::cmpeq(block_first, first), simd::cmpeq(block_last, last))
+        );
+        while (mask != 0) {
+            const u64 candidate = idx + bit::ctz(mask);
+            if (needle.len <= 2 ||
+                bytes_equal(haystack.ptr + candidate + 1, needle.ptr + 1, needle.len - 2)) {
+                *out_idx = candidate;
+                return true;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; idx <= last_start; ++idx) {
+        if (haystack.ptr[idx] == needle.ptr[0] &&
+            bytes_equal(haystack.ptr + idx, needle.ptr, needle.len)) {
+            *out_idx = idx;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool
+find_last_bytes(const Slice<u8> haystack, const Slice<u8> needle, u64* out_idx) {
+    if (needle.len > haystack.len) return false;
+    if (haystack.len == 0 || needle.len == 0) return false;
+
+    // Two-Way over the reversed haystack and needle, its first match is the last one here
+    if (needle.len > SIMD_MAX_NEEDLE) {
+        u64 reversed_idx = 0;
+        if (!two_way_find(
+                ByteView<true>{ haystack.ptr, (i64)haystack.len },
+                ByteView<true>{ needle.ptr, (i64)needle.len },
+                &reversed_idx
+            ))
+            return false;
+
+        *out_idx = haystack.len - needle.len - reversed_idx;
+        return true;
+    }
+
+    // One past the last candidate position
+    u64 end = haystack.len - needle.len + 1;
+
+#if ARCH_X64
+    const simd::U8x first = simd::splat(needle.ptr[0]);
+    const simd::U8x last = simd::splat(needle.ptr[needle.len - 1]);
+    for (; end >= simd::WIDTH; end -= simd::WIDTH) {
+        const u64 idx = end - simd::WIDTH;
+        const simd::U8x block_first = simd::load(haystack.ptr + idx);
+        const simd::U8x block_last = simd::load(haystack.ptr + idx + needle.len - 1);
+        u32 mask = simd::movemask(
+            simd::bit_and(simd::cmpeq(block_first, first), simd::cmpeq(block_last, last))
+        );
+        while (mask != 0) {
+            const u32 bit = bit::log2(mask);
+            const u64 candidate = idx + bit;
+            if (needle.len <= 2 ||
+                bytes_equal(haystack.ptr + candidate + 1, needle.ptr + 1, needle.len - 2)) {
+                *out_idx = candidate;
+                return true;
+            }
+            mask &= ~((u32)1 << bit);
+        }
+    }
+#endif
+
+    while (end > 0) {
+        --end;
+        if (haystack.ptr[end] == needle.ptr[0] &&
+            bytes_equal(haystack.ptr + end, needle.ptr, needle.len)) {
+            *out_idx = end;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#if ARCH_X64
+// Bit per byte of the block, set for bytes in the listed set
+static u32
+set_mask(const simd::U8x block, const simd::U8x* listed, const u64 count) {
+    simd::U8x matches = simd::cmpeq(block, listed[0]);
+    for (u64 i = 1; i < count; ++i) matches = simd::bit_or(matches, simd::cmpeq(block, listed[i]));
+    return simd::movemask(matches);
+}
+#endif
+
+static u64
+scan_set(const Slice<u8> slice, const u64 start, const ByteSet& set, const bool in_set) {
+    u64 idx = start;
+
+#if ARCH_X64
+    // Small sets compare a whole block against every member, larger ones use the table only
+    if (!set.overflow && set.listed_count != 0) {
+        simd::U8x listed[ByteSet::MAX_LISTED];
+        for (u64 i = 0; i < set.listed_count; ++i) listed[i] = simd::splat(set.listed[i]);
+
+        const u32 flip = in_set ? 0 : simd::FULL_MASK;
+        for (; idx + simd::WIDTH <= slice.len; idx += simd::WIDTH) {
+            const u32 mask =
+                set_mask(simd::load(slice.ptr + idx), listed, set.listed_count) ^ flip;
+            if (mask != 0) return idx + bit::ctz(mask);
+        }
+    }
+#endif
+
+    while (idx < slice.len && set.contains(slice.ptr[idx]) != in_set) ++idx;
+    return idx;
+}
+
+u64
+find_in_set_bytes(const Slice<u8> slice, const u64 start, const ByteSet& set) {
+    return scan_set(slice, start, set, true);
+}
+
+u64
+find_not_in_set_bytes(const Slice<u8> slice, const u64 start, const ByteSet& set) {
+    return scan_set(slice, start, set, false);
+}
 
+} // namespace mem
 } // namespace mksv
 
 bool
@@ -0,0 +1,214 @@
+#include "multi_matcher.hpp"
+
+#include "utils.hpp"
+
+namespace mksv {
+namespace mem {
+
+template <typename T>
+static void
+free_if_allocated(const Allocator allocator, const Slice<T> buf) {
+    if (buf.ptr != nullptr) allocator.free(buf);
+}
+
+void
+MultiMatcher::deinit() {
+    free_if_allocated(allocator, transitions);
+    free_if_allocated(allocator, state_pattern);
+    free_if_allocated(allocator, output_link);
+    free_if_allocated(allocator, next_pattern);
+    free_if_allocated(allocator, pattern_len);
+    transitions = {};
+    state_pattern = {};
+    output_link = {};
+    next_pattern = {};
+    pattern_len = {};
+}
+
+bool
+MultiMatcher::init(
+    const Allocator allocator,
+    const Slice<Str> patterns,
+    MultiMatcher* out_matcher
+) {
+    if (patterns.len >= NONE) return false;
+
+    MultiMatcher m = {
+        .allocator = allocator,
+        .byte_class = {},
+        .class_count = 0,
+        .state_count = 1,
+        .transitions = {},
+        .state_pattern = {},
+        .output_link = {},
+        .next_pattern = {},
+        .pattern_len = {},
+    };
+
+    // Class 0 is every byte that appears in no pattern
+    u64 max_states = 1;
+    u32 class_count = 1;
+    for (const Str pattern : patterns) {
+        max_states += pattern.len;
+        for (const u8 c : pattern) {
+            if (m.byte_class[c] == 0) m.byte_class[c] = (u16)class_count++;
+        }
+    }
+    // Keeps row offsets in u32 range
+    if (max_states * class_count >= OUTPUT_FLAG) return false;
+    m.class_count = class_count;
+
+    bool ok = false;
+    defer(if (!ok) m.deinit());
+
+    if (!allocator.alloc(max_states * class_count, &m.transitions)) return false;
+    if (!allocator.alloc(max_states, &m.state_pattern)) return false;
+    if (!allocator.alloc(max_states, &m.output_link)) return false;
+    if (patterns.len != 0) {
+        if (!allocator.alloc(patterns.len, &m.next_pattern)) return false;
+        if (!allocator.alloc(patterns.len, &m.pattern_len)) return false;
+    }
+
+    for (u32& target : m.transitions) target = NONE;
+    for (u32& pattern : m.state_pattern) pattern = NONE;
+    for (u32& link : m.output_link) link = NONE;
+
+    // Trie
+    for (u32 id = 0; id < (u32)patterns.len; ++id) {
+        const Str pattern = patterns[id];
+        m.pattern_len[id] = pattern.len;
+        m.next_pattern[id] = NONE;
+        if (pattern.len == 0) continue;
+
+        u32 state = 0;
+        for (const u8 c : pattern) {
+            u32* target = &m.transitions[state * class_count + m.byte_class[c]];
+            if (*target == NONE) *target = m.state_count++;
+            state = *target;
+        }
+
+        m.next_pattern[id] = m.state_pattern[state];
+        m.state_pattern[state] = id;
+    }
+
+    // Breadth first, so the failure state of a node is complete before its children read it.
+    // Missing transitions are replaced by the failure state's, which turns the trie into a DFA
+    Slice<u32> fail = {};
+    Slice<u32> queue = {};
+    if (!allocator.alloc(m.state_count, &fail)) return false;
+    defer(allocator.free(fail));
+    if (!allocator.alloc(m.state_count, &queue)) return false;
+    defer(allocator.free(queue));
+
+    u64 head = 0;
+    u64 tail = 0;
+    for (u32 c = 0; c < class_count; ++c) {
+        u32* target = &m.transitions[c];
+        if (*target == NONE) {
+            *target = 0;
+        } else {
+            fail[*target] = 0;
+            queue[tail++] = *target;
+        }
+    }
+
+    while (head < tail) {
+        const u32 state = queue[head++];
+        const u32* fail_row = &m.transitions[fail[state] * class_count];
+        u32* row = &m.transitions[state * class_count];
+
+        for (u32 c = 0; c < class_count; ++c) {
+            if (row[c] == NONE) {
+                row[c] = fail_row[c];
+                continue;
+            }
+
+            const u32 child = row[c];
+            const u32 child_fail = fail_row[c];
+            fail[child] = child_fail;
+            m.output_link[child] =
+                m.state_pattern[child_fail] != NONE ? child_fail : m.output_link[child_fail];
+            queue[tail++] = child;
+        }
+    }
+
+    for (u32& target : Slice<u32>{ m.transitions.ptr, m.state_count * class_count }) {
+        if (m.state_pattern[target] != NONE || m.output_link[target] != NONE) {
+            target |= OUTPUT_FLAG;
+        }
+    }
+
+    // The trie usually shares prefixes, give back the unused rows
+    const u64 used = (u64)m.state_count * class_count;
+    if (used != m.transitions.len && allocator.resize(m.transitions, used)) {
+        m.transitions.len = used;
+    }
+
+    ok = true;
+    *out_matcher = m;
+
+    return true;
+}
+
+MultiMatchIter
+MultiMatcher::matches(const Str haystack) const {
+    return {
+        .matcher = this,
+        .haystack = haystack,
+        .index = 0,
+        .state = 0,
+        .output_state = NONE,
+        .output_pattern = NONE,
+    };
+}
+
+bool
+MultiMatchIter::next(MultiMatch* out_match) {
+    const MultiMatcher* m = matcher;
+
+    while (output_pattern == MultiMatcher::NONE) {
+        if (output_state != MultiMatcher::NONE) {
+            output_state = m->output_link[output_state];
+            if (output_state != MultiMatcher::NONE) {
+                output_pattern = m->state_pattern[output_state];
+            }
+            continue;
+        }
+
+        // Every target is a row of the table and index stays below haystack.len, so the hot
+        // loop indexes the raw pointers without a bounds check per byte
+        assert(m->transitions.len >= (u64)m->state_count * m->class_count);
+        const u32* transitions = m->transitions.ptr;
+        const u16* byte_class = m->byte_class;
+        const u8* bytes = haystack.ptr;
+        const u64 class_count = m->class_count;
+        const u64 len = haystack.len;
+
+        // Hot loop, one table load per byte until a state with matches is reached
+        u32 target = state;
+        while (index < len) {
+            target = transitions[state * class_count + byte_class[bytes[index]]];
+            ++index;
+            state = target & ~MultiMatcher::OUTPUT_FLAG;
+            if (target & MultiMatcher::OUTPUT_FLAG) break;
+        }
+        if (!(target & MultiMatcher::OUTPUT_FLAG)) return false;
+
+        output_state = state;
+        output_pattern = m->state_pattern[state];
+    }
+
+    const u64 len = m->pattern_len[output_pattern];
+    *out_match = MultiMatch{
+        .start = index - len,
+        .end = index,
+        .pattern = output_pattern,
+    };
+
+    output_pattern = m->next_pattern[output_pattern];
+
+    return true;
+}
+
+} // namespace mem
+} // namespace mksv
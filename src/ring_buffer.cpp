@@ -0,0 +1,192 @@
+#include "ring_buffer.hpp"
+
+#include "ctx.hpp"
+#include "fmt.hpp"
+#include "mem.hpp"
+
+#if OS_WINDOWS
+#include <windows.h>
+#endif
+#if OS_MACOS | OS_LINUX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace mksv {
+
+static u64
+allocation_granularity() {
+#if OS_WINDOWS
+    SYSTEM_INFO sys_info = {};
+    GetSystemInfo(&sys_info);
+    return (u64)sys_info.dwAllocationGranularity;
+#elif OS_MACOS | OS_LINUX
+    return (u64)getpagesize();
+#else
+#error "Unsupported OS"
+#endif
+}
+
+#if OS_MACOS | OS_LINUX
+// Shared memory object that is not visible in the file system
+static int
+anonymous_file(const u64 size) {
+#if OS_LINUX
+    const int fd = memfd_create("mksv_ring_buffer", MFD_CLOEXEC);
+#else
+    static u64 counter = 0;
+
+    int fd = -1;
+    for (u64 attempt = 0; attempt < 16 && fd < 0; ++attempt) {
+        u8 name[64] = {};
+        const Str fmt_name = fmt::format(
+            Str{ name, sizeof(name) - 1 }, "/mksv_ring_{u64}_{u64}", (u64)getpid(), counter++
+        );
+        if (fmt_name.ptr == nullptr) return -1;
+
+        fd = shm_open((const char*)name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd >= 0) shm_unlink((const char*)name);
+    }
+#endif
+    if (fd < 0) return -1;
+
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+#endif
+
+bool
+RingBuffer::init(const u64 min_capacity, RingBuffer* out_ring) {
+    const u64 capacity = mem::align_up(math::max(min_capacity, (u64)1), allocation_granularity());
+
+#if OS_WINDOWS
+    const HANDLE mapping = CreateFileMappingA(
+        INVALID_HANDLE_VALUE,
+        nullptr,
+        PAGE_READWRITE,
+        (DWORD)(capacity >> 32),
+        (DWORD)(capacity & 0xFFFF'FFFF),
+        nullptr
+    );
+    if (mapping == nullptr) return false;
+
+    // Find a free range then map both views into it, another thread may grab the range in
+    // between so retry a few times
+    u8* base = nullptr;
+    for (u64 attempt = 0; attempt < 16 && base == nullptr; ++attempt) {
+        u8* range = (u8*)VirtualAlloc(nullptr, 2 * capacity, MEM_RESERVE, PAGE_NOACCESS);
+        if (range == nullptr) break;
+        VirtualFree(range, 0, MEM_RELEASE);
+
+        void* first = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, capacity, range);
+        void* second =
+            MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, capacity, range + capacity);
+        if (first == range && second == range + capacity) {
+            base = range;
+            break;
+        }
+
+        if (first) UnmapViewOfFile(first);
+        if (second) UnmapViewOfFile(second);
+    }
+
+    // The views keep the mapping alive
+    CloseHandle(mapping);
+    if (base == nullptr) return false;
+#elif OS_MACOS | OS_LINUX
+    const int fd = anonymous_file(capacity);
+    if (fd < 0) return false;
+
+    u8* base = (u8*)mmap(nullptr, 2 * capacity, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    const int prot = PROT_READ | PROT_WRITE;
+    const bool mapped =
+        mmap(base, capacity, prot, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED &&
+        mmap(base + capacity, capacity, prot, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED;
+
+    // The mappings keep the file alive
+    close(fd);
+    if (!mapped) {
+        munmap(base, 2 * capacity);
+        return false;
+    }
+#else
+#error "Unsupported OS"
+#endif
+
+    *out_ring = {
+        .buffer = { base, capacity },
+        .read_idx = 0,
+        .size = 0,
+    };
+
+    return true;
+}
+
+void
+RingBuffer::deinit() {
+    if (buffer.ptr == nullptr) return;
+
+#if OS_WINDOWS
+    UnmapViewOfFile(buffer.ptr);
+    UnmapViewOfFile(buffer.ptr + buffer.len);
+#elif OS_MACOS | OS_LINUX
+    munmap(buffer.ptr, 2 * buffer.len);
+#else
+#error "Unsupported OS"
+#endif
+
+    *this = {};
+}
+
+Str
+RingBuffer::readable() const {
+    return Str{ buffer.ptr + read_idx, size };
+}
+
+Str
+RingBuffer::writable() const {
+    const u64 write_idx = (read_idx + size) % buffer.len;
+    return Str{ buffer.ptr + write_idx, buffer.len - size };
+}
+
+void
+RingBuffer::commit(const u64 len) {
+    assert(len <= buffer.len - size);
+    size += len;
+}
+
+void
+RingBuffer::consume(const u64 len) {
+    assert(len <= size);
+    read_idx = (read_idx + len) % buffer.len;
+    size -= len;
+}
+
+bool
+RingBuffer::write(const Str data) {
+    const Str dst = writable();
+    if (data.len > dst.len) return false;
+
+    mem::copy(Str{ dst.ptr, data.len }, data);
+    commit(data.len);
+
+    return true;
+}
+
+void
+RingBuffer::clear() {
+    read_idx = 0;
+    size = 0;
+}
+
+} // namespace mksv
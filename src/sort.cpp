@@ -0,0 +1,33 @@
+#include "sort.hpp"
+
+namespace mksv {
+namespace mem {
+
+template <typename K>
+static bool
+radix_sort_keys(const Allocator allocator, const Slice<K> keys) {
+    if (keys.len < RADIX_MIN_LEN) {
+        sort(keys, [](const K a, const K b) { return radix_key(a) < radix_key(b); });
+        return true;
+    }
+
+    return radix_sort_impl(allocator, keys, Slice<u8>{});
+}
+
+bool
+radix_sort(const Allocator allocator, const Slice<u32> keys) {
+    return radix_sort_keys(allocator, keys);
+}
+
+bool
+radix_sort(const Allocator allocator, const Slice<u64> keys) {
+    return radix_sort_keys(allocator, keys);
+}
+
+bool
+radix_sort(const Allocator allocator, const Slice<f32> keys) {
+    return radix_sort_keys(allocator, keys);
+}
+
+} // namespace mem
+} // namespace mksv
@@ -0,0 +1,146 @@
+#include "thread.hpp"
+
+#include "ctx.hpp"
+#include "mem.hpp"
+
+#if OS_WINDOWS
+#include <windows.h>
+#endif
+#if OS_MACOS | OS_LINUX
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+namespace mksv {
+namespace thread {
+
+#if OS_WINDOWS
+using Handle = HANDLE;
+
+static DWORD WINAPI
+thread_start(LPVOID arg) {
+    Thread* thread = (Thread*)arg;
+    thread->fn(thread->ctx);
+    return 0;
+}
+#elif OS_MACOS | OS_LINUX
+using Handle = pthread_t;
+
+static void*
+thread_start(void* arg) {
+    Thread* thread = (Thread*)arg;
+    thread->fn(thread->ctx);
+    return nullptr;
+}
+#else
+#error "Unsupported OS"
+#endif
+
+static_assert(sizeof(Handle) <= sizeof(u64));
+
+static void
+set_handle(Thread* thread, Handle handle) {
+    thread->handle = 0;
+    mem::copy(
+        mem::Slice<u8>{ (u8*)&thread->handle, sizeof(Handle) },
+        mem::Slice<u8>{ (u8*)&handle, sizeof(Handle) }
+    );
+}
+
+static Handle
+get_handle(const Thread* thread) {
+    Handle handle = {};
+    mem::copy(
+        mem::Slice<u8>{ (u8*)&handle, sizeof(Handle) },
+        mem::Slice<u8>{ (u8*)&thread->handle, sizeof(Handle) }
+    );
+    return handle;
+}
+
+bool
+Thread::spawn(const ThreadFn fn, void* ctx, Thread* out_thread) {
+    out_thread->fn = fn;
+    out_thread->ctx = ctx;
+
+#if OS_WINDOWS
+    const HANDLE handle = CreateThread(nullptr, 0, thread_start, out_thread, 0, nullptr);
+    if (handle == nullptr) return false;
+#elif OS_MACOS | OS_LINUX
+    pthread_t handle = {};
+    if (pthread_create(&handle, nullptr, thread_start, out_thread) != 0) return false;
+#else
+#error "Unsupported OS"
+#endif
+
+    set_handle(out_thread, handle);
+
+    return true;
+}
+
+void
+Thread::join() {
+    const Handle h = get_handle(this);
+
+#if OS_WINDOWS
+    WaitForSingleObject(h, INFINITE);
+    CloseHandle(h);
+#elif OS_MACOS | OS_LINUX
+    pthread_join(h, nullptr);
+#else
+#error "Unsupported OS"
+#endif
+}
+
+u32
+cpu_count() {
+#if OS_WINDOWS
+    SYSTEM_INFO sys_info = {};
+    GetSystemInfo(&sys_info);
+    const i64 count = (i64)sys_info.dwNumberOfProcessors;
+#elif OS_MACOS | OS_LINUX
+    const i64 count = (i64)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+#error "Unsupported OS"
+#endif
+
+    return count < 1 ? 1 : (u32)count;
+}
+
+struct Task {
+    TaskFn fn;
+    void* ctx;
+    u32 index;
+};
+
+static void
+run_task(void* arg) {
+    const Task* task = (const Task*)arg;
+    task->fn(task->ctx, task->index);
+}
+
+void
+run_parallel(const u32 task_count, const TaskFn fn, void* ctx) {
+    assert(task_count <= MAX_TASKS);
+
+    Task tasks[MAX_TASKS];
+    Thread threads[MAX_TASKS];
+    bool spawned[MAX_TASKS];
+
+    for (u32 i = 1; i < task_count; ++i) {
+        tasks[i] = Task{ .fn = fn, .ctx = ctx, .index = i };
+        spawned[i] = Thread::spawn(run_task, &tasks[i], &threads[i]);
+    }
+
+    fn(ctx, 0);
+
+    for (u32 i = 1; i < task_count; ++i) {
+        if (spawned[i]) {
+            threads[i].join();
+        } else {
+            fn(ctx, i);
+        }
+    }
+}
+
+} // namespace thread
+} // namespace mksv
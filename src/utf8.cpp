@@ -0,0 +1,291 @@
+#include "utf8.hpp"
+
+#include "bit.hpp"
+#include "simd.hpp"
+
+namespace mksv {
+namespace utf8 {
+
+static bool
+is_continuation(const u8 c) {
+    return (c & 0xC0) == 0x80;
+}
+
+bool
+decode(const Str text, const u64 index, u32* out_codepoint, u64* out_len) {
+    assert(index < text.len);
+
+    const u8* s = text.ptr + index;
+    const u64 available = text.len - index;
+    const u8 lead = s[0];
+
+    if (lead < 0x80) {
+        *out_codepoint = lead;
+        *out_len = 1;
+        return true;
+    }
+
+    // Range of the second byte, narrower than 0x80..0xBF for the leads that could produce an
+    // overlong encoding, a surrogate or a codepoint above U+10FFFF
+    u64 len = 0;
+    u8 low = 0x80;
+    u8 high = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        len = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        len = 3;
+        if (lead == 0xE0) low = 0xA0;
+        if (lead == 0xED) high = 0x9F;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        len = 4;
+        if (lead == 0xF0) low = 0x90;
+        if (lead == 0xF4) high = 0x8F;
+    } else {
+        return false;
+    }
+
+    if (available < len) return false;
+    if (s[1] < low || s[1] > high) return false;
+
+    u32 codepoint = (u32)(lead & (0xFF >> (len + 1)));
+    for (u64 i = 1; i < len; ++i) {
+        if (!is_continuation(s[i])) return false;
+        codepoint = (codepoint << 6) | (s[i] & 0x3F);
+    }
+
+    *out_codepoint = codepoint;
+    *out_len = len;
+
+    return true;
+}
+
+#if ARCH_X64 && (SIMD_LOOKUP || SIMD_LOOKUP_DISPATCH)
+// Lookup validation from "Validating UTF-8 In Less Than One Instruction Per Byte" (Keiser and
+// Lemire). Every byte pair is classified by three 16 entry tables (high nibble of the first byte,
+// low nibble of the first byte, high nibble of the second byte) whose AND is non zero for an error.
+// The remaining errors, a missing continuation after a 3 or 4 byte lead, are checked separately
+constexpr u8 TOO_SHORT = 1 << 0;
+constexpr u8 TOO_LONG = 1 << 1;
+constexpr u8 OVERLONG_3 = 1 << 2;
+constexpr u8 TOO_LARGE = 1 << 3;
+constexpr u8 SURROGATE = 1 << 4;
+constexpr u8 OVERLONG_2 = 1 << 5;
+constexpr u8 TOO_LARGE_1000 = 1 << 6;
+constexpr u8 OVERLONG_4 = 1 << 6;
+constexpr u8 TWO_CONTS = 1 << 7;
+constexpr u8 CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+constexpr u8 BYTE_1_HIGH[16] = {
+    TOO_LONG,
+    TOO_LONG,
+    TOO_LONG,
+    TOO_LONG,
+    TOO_LONG,
+    TOO_LONG,
+    TOO_LONG,
+    TOO_LONG,
+    TWO_CONTS,
+    TWO_CONTS,
+    TWO_CONTS,
+    TWO_CONTS,
+    TOO_SHORT | OVERLONG_2,
+    TOO_SHORT,
+    TOO_SHORT | OVERLONG_3 | SURROGATE,
+    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,
+};
+
+constexpr u8 BYTE_1_LOW[16] = {
+    CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+    CARRY | OVERLONG_2,
+    CARRY,
+    CARRY,
+    CARRY | TOO_LARGE,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+};
+
+constexpr u8 BYTE_2_HIGH[16] = {
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+};
+
+struct Validator {
+    simd::U8x byte_1_high;
+    simd::U8x byte_1_low;
+    simd::U8x byte_2_high;
+    // Per byte upper bound of a lead that is complete within the block
+    simd::U8x incomplete_max;
+    simd::U8x low_nibble;
+    simd::U8x prev_block;
+    // Leads at the end of the previous block that need continuations
+    simd::U8x prev_incomplete;
+    simd::U8x error;
+};
+
+SIMD_LOOKUP_TARGET static Validator
+validator_init() {
+    u8 incomplete_max[simd::WIDTH];
+    for (u64 i = 0; i < simd::WIDTH; ++i) incomplete_max[i] = 0xFF;
+    incomplete_max[simd::WIDTH - 3] = 0xF0 - 1;
+    incomplete_max[simd::WIDTH - 2] = 0xE0 - 1;
+    incomplete_max[simd::WIDTH - 1] = 0xC0 - 1;
+
+    return {
+        .byte_1_high = simd::table16(BYTE_1_HIGH),
+        .byte_1_low = simd::table16(BYTE_1_LOW),
+        .byte_2_high = simd::table16(BYTE_2_HIGH),
+        .incomplete_max = simd::load(incomplete_max),
+        .low_nibble = simd::splat(0x0F),
+        .prev_block = simd::zero(),
+        .prev_incomplete = simd::zero(),
+        .error = simd::zero(),
+    };
+}
+
+SIMD_LOOKUP_TARGET static void
+validator_step(Validator* v, const simd::U8x block) {
+    if (simd::movemask(block) == 0) {
+        // An ASCII block can't complete the previous one
+        v->error = simd::bit_or(v->error, v->prev_incomplete);
+    } else {
+        const simd::U8x prev1 = simd::prev<1>(block, v->prev_block);
+        const simd::U8x special_cases = simd::bit_and(
+            simd::bit_and(
+                simd::lookup16(v->byte_1_high, simd::shift_right4(prev1)),
+                simd::lookup16(v->byte_1_low, simd::bit_and(prev1, v->low_nibble))
+            ),
+            simd::lookup16(v->byte_2_high, simd::shift_right4(block))
+        );
+
+        // Only 111_____ (third byte of a sequence) and 1111____ (fourth) reach 0x80
+        const simd::U8x prev2 = simd::prev<2>(block, v->prev_block);
+        const simd::U8x prev3 = simd::prev<3>(block, v->prev_block);
+        const simd::U8x must_be_continuation = simd::bit_or(
+            simd::sub_saturate(prev2, simd::splat(0xE0 - 0x80)),
+            simd::sub_saturate(prev3, simd::splat(0xF0 - 0x80))
+        );
+        const simd::U8x lengths = simd::bit_xor(
+            simd::bit_and(must_be_continuation, simd::splat(0x80)), special_cases
+        );
+
+        v->error = simd::bit_or(v->error, lengths);
+        v->prev_incomplete = simd::sub_saturate(block, v->incomplete_max);
+    }
+
+    v->prev_block = block;
+}
+
+SIMD_LOOKUP_TARGET static bool
+validate_lookup(const Str text) {
+    Validator v = validator_init();
+
+    u64 idx = 0;
+    for (; idx + simd::WIDTH <= text.len; idx += simd::WIDTH) {
+        validator_step(&v, simd::load(text.ptr + idx));
+    }
+
+    // Tail padded with zeros, it can't end with an incomplete lead so this also checks the last
+    // full block
+    u8 tail[simd::WIDTH] = {};
+    mem::copy(Str{ tail, text.len - idx }, text.sub(idx, text.len));
+    validator_step(&v, simd::load(tail));
+
+    return simd::movemask(simd::cmpeq(v.error, simd::zero())) == simd::FULL_MASK;
+}
+#endif
+
+#if !SIMD_LOOKUP
+static bool
+validate_scalar(const Str text) {
+    u64 idx = 0;
+    while (idx < text.len) {
+#if ARCH_X64
+        // Skip ASCII a block at a time, only the other bytes go through decode()
+        if (idx + simd::WIDTH <= text.len && simd::movemask(simd::load(text.ptr + idx)) == 0) {
+            idx += simd::WIDTH;
+            continue;
+        }
+#endif
+
+        u32 codepoint = 0;
+        u64 len = 0;
+        if (!decode(text, idx, &codepoint, &len)) return false;
+        idx += len;
+    }
+
+    return true;
+}
+#endif
+
+bool
+validate(const Str text) {
+#if ARCH_X64 && SIMD_LOOKUP
+    return validate_lookup(text);
+#elif ARCH_X64 && SIMD_LOOKUP_DISPATCH
+    if (simd::has_lookup()) return validate_lookup(text);
+    return validate_scalar(text);
+#else
+    return validate_scalar(text);
+#endif
+}
+
+bool
+CodepointIter::next(u32* out_codepoint) {
+    if (index == text.len) return false;
+
+#if ARCH_X64
+    if (index >= ascii_end && index + simd::WIDTH <= text.len) {
+        const u32 mask = simd::movemask(simd::load(text.ptr + index));
+        ascii_end = index + (mask == 0 ? simd::WIDTH : bit::ctz(mask));
+    }
+#endif
+
+    if (index < ascii_end) {
+        *out_codepoint = text.ptr[index++];
+        return true;
+    }
+
+    u64 len = 0;
+    if (!decode(text, index, out_codepoint, &len)) {
+        *out_codepoint = REPLACEMENT_CHARACTER;
+        len = 1;
+    }
+    index += len;
+
+    return true;
+}
+
+CodepointIter
+codepoints(const Str text) {
+    return {
+        .text = text,
+        .index = 0,
+        .ascii_end = 0,
+    };
+}
+
+} // namespace utf8
+} // namespace mksv
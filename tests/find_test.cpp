@@ -0,0 +1,81 @@
+#include "fmt.hpp"
+#include "mem.hpp"
+
+using namespace mksv;
+
+static u64 rng_state = 0x9E37'79B9'7F4A'7C15;
+
+static u64
+rng_next() {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static bool
+naive_find(const Str haystack, const Str needle, const bool from_end, u64* out_idx) {
+    if (needle.len == 0 || needle.len > haystack.len) return false;
+
+    const u64 count = haystack.len - needle.len + 1;
+    for (u64 n = 0; n < count; ++n) {
+        const u64 idx = from_end ? count - 1 - n : n;
+        u64 i = 0;
+        while (i < needle.len && haystack.ptr[idx + i] == needle.ptr[i]) ++i;
+        if (i == needle.len) {
+            *out_idx = idx;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Small alphabets make repetitive inputs, which is where Two-Way's periodic case and the vector
+// filter's false candidates show up. Needle lengths cross the Two-Way threshold and haystack
+// lengths cross the vector tails
+int
+main() {
+    constexpr u64 ITERATIONS = 200'000;
+
+    u8 haystack[600];
+    u8 needle[80];
+    u64 failures = 0;
+
+    for (u64 iter = 0; iter < ITERATIONS; ++iter) {
+        const u64 alphabet = 1 + rng_next() % 3;
+        const u64 n = rng_next() % sizeof(haystack);
+        const u64 m = 1 + rng_next() % sizeof(needle);
+
+        for (u64 i = 0; i < n; ++i) haystack[i] = (u8)('a' + rng_next() % alphabet);
+        for (u64 i = 0; i < m; ++i) needle[i] = (u8)('a' + rng_next() % alphabet);
+        if (n >= m && rng_next() % 2 == 0) {
+            const u64 at = rng_next() % (n - m + 1);
+            mem::copy(Str{ haystack + at, m }, Str{ needle, m });
+        }
+
+        const Str h = { haystack, n };
+        const Str x = { needle, m };
+
+        for (u32 direction = 0; direction < 2; ++direction) {
+            const bool from_end = direction == 1;
+            u64 expected = 0;
+            u64 actual = 0;
+            const bool expected_found = naive_find(h, x, from_end, &expected);
+            const bool found = from_end ? mem::find_last(h, x, &actual) : mem::find(h, x, &actual);
+            if (found != expected_found || (found && actual != expected)) {
+                ++failures;
+                (void)fmt::print_stderr(
+                    "find{s} mismatch: haystack {u64} B, needle {u64} B\n",
+                    from_end ? Str{ "_last" } : Str{ "" },
+                    n,
+                    m
+                );
+            }
+        }
+    }
+
+    (void)fmt::print_stdout("find_test: {u64} failures\n", failures);
+
+    return failures == 0 ? 0 : 1;
+}
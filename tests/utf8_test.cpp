@@ -0,0 +1,85 @@
+#include "fmt.hpp"
+#include "utf8.hpp"
+
+using namespace mksv;
+
+static u64 rng_state = 0x2545'F491'4F6C'DD1D;
+
+static u64
+rng_next() {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// Scalar reference, one decode() per sequence
+static bool
+validate_reference(const Str text) {
+    u64 idx = 0;
+    while (idx < text.len) {
+        u32 codepoint = 0;
+        u64 len = 0;
+        if (!utf8::decode(text, idx, &codepoint, &len)) return false;
+        idx += len;
+    }
+
+    return true;
+}
+
+// Texts are built from valid sequences of every length with an occasional invalid piece, so errors
+// land at every offset of the 16 and 32 byte blocks, including across block boundaries. The
+// Makefile runs this against the dispatched, SSSE3 and AVX2 builds of validate()
+int
+main() {
+    constexpr u64 ITERATIONS = 300'000;
+
+    const Str valid[] = {
+        "a",
+        "\xC3\xA9",
+        "\xE2\x82\xAC",
+        "\xF0\x9F\x98\x80",
+    };
+    const Str invalid[] = {
+        "\xED\xA0\x80", // surrogate
+        "\xC0\xAF", // overlong
+        "\xE0\x80\xAF", // overlong
+        "\xF4\x90\x80\x80", // above U+10FFFF
+        "\x80", // lone continuation
+        "\xE2\x82", // truncated
+        "\xF0\x9F", // truncated
+        "\xFF",
+    };
+
+    u8 buffer[300];
+    u64 valid_count = 0;
+    u64 failures = 0;
+
+    for (u64 iter = 0; iter < ITERATIONS; ++iter) {
+        u64 len = 0;
+        const u64 pieces = rng_next() % 80;
+        for (u64 p = 0; p < pieces; ++p) {
+            const bool is_valid = rng_next() % 100 < 93;
+            const Str piece = is_valid ? valid[rng_next() % 4] : invalid[rng_next() % 8];
+            if (len + piece.len > sizeof(buffer)) break;
+            mem::copy(Str{ buffer + len, piece.len }, piece);
+            len += piece.len;
+        }
+
+        const Str text = { buffer, len };
+        const bool expected = validate_reference(text);
+        valid_count += expected;
+        if (utf8::validate(text) != expected) {
+            ++failures;
+            (void)fmt::print_stderr(
+                "validate mismatch: {u64} B, expected {u64}\n", len, (u64)expected
+            );
+        }
+    }
+
+    (void)fmt::print_stdout(
+        "utf8_test: {u64} failures, {u64} valid of {u64}\n", failures, valid_count, ITERATIONS
+    );
+
+    return failures == 0 ? 0 : 1;
+}